@@ -1,10 +1,25 @@
 #include "Graph.h"
+#include "PprAccumulator.h"
 
-Graph::Graph(string data_dir) : data_dir(data_dir) {
-    char splitter = ' ';
-    
+Graph::Graph(string data_dir, bool build_reverse) : data_dir(data_dir) {
+    _load_attribute();
+    shard_begin = 0;
+    shard_end = node_count;
+    _construct(build_reverse);
+}
+
+// Loads only the out-edges of the nodes in shard shard_id of shard_count equal node ranges.
+// Nodes of other shards have no out-edges in this Graph.
+Graph::Graph(string data_dir, int shard_id, int shard_count) : data_dir(data_dir) {
+    assert(shard_id >= 0 && shard_id < shard_count);
     _load_attribute();
+    Node shard_size = get_shard_size(shard_count);
+    shard_begin = min(node_count, shard_id * shard_size);
+    shard_end = min(node_count, shard_begin + shard_size);
+    _construct(false);
+}
 
+void Graph::_construct(bool build_reverse) {
     map<Node, set<Node>> adj_list_list;
     _load_edge_from_txt(adj_list_list);
 
@@ -20,9 +35,19 @@ Graph::Graph(string data_dir) : data_dir(data_dir) {
     }
     start_suf_list.push_back(current_edge_count);
 
-    gen = mt19937(rd());
-    rand_0_1 = uniform_real_distribution<>(0.0, 1.0);
-    rand_int = uniform_int_distribution<>(0, INT_MAX);
+    // construct reverse CSR by counting in-degrees. Each in-adjacency range is sorted as well.
+    if (build_reverse) {
+        in_start_suf_list.assign(node_count + 1, 0);
+        for (Node end_id : end_node_list) in_start_suf_list[end_id + 1]++;
+        for (Node node_id = 0; node_id < node_count; node_id++) in_start_suf_list[node_id + 1] += in_start_suf_list[node_id];
+        in_end_node_list.resize(end_node_list.size());
+        vector<Edge> fill_suf_list(in_start_suf_list.begin(), in_start_suf_list.end() - 1);
+        for (Node src_id = 0; src_id < node_count; src_id++) {
+            for (Edge edge_suf = start_suf_list[src_id]; edge_suf < start_suf_list[src_id + 1]; edge_suf++) {
+                in_end_node_list[fill_suf_list[end_node_list[edge_suf]]++] = src_id;
+            }
+        }
+    }
 
     return;
 }
@@ -36,6 +61,12 @@ vector<Graph::Node> Graph::get_adj_list(Node node_id) const {
     return adj_list;
 }
 
+vector<Graph::Node> Graph::get_in_adj_list(Node node_id) const {
+    assert(has_reverse());
+    Edge start_suf = in_start_suf_list.at(node_id);
+    return vector<Graph::Node>(in_end_node_list.begin() + start_suf, in_end_node_list.begin() + in_start_suf_list.at(node_id + 1));
+}
+
 Graph::Node Graph::get_random_adjacent(Node node_id) const {
     int degree = get_adj_num(node_id);
     if (degree == 0) return -1;
@@ -56,61 +87,49 @@ void Graph::get_paths_by_mc(Node source_id, double alpha, long long walk_count,
     }
 }
 
-void Graph::get_paths_by_thunderRW(Node source_id, double alpha, long long walk_count, vector<vector<Node>>& paths) const {
-    struct WalkerMeta {
-        long long id_;
-        Node current_;
-    };
+// The ring of ThunderRW shared by the walk functions below.
+// Walkers 0, ..., walk_count - 1 are loaded into ring_size slots, and each round moves every walker in the ring
+// by one step in stages, prefetching the degree and then the neighbor of all slots before they are read,
+// so that the cache misses of different walkers overlap. Walk decides what a walk is:
+//   Walk::State                          per-walker state with Node current_
+//   void start(long long id, State& w)   initializes walker id
+//   bool keep_walking(State& w)          termination check before every step, also right after start
+//   void prefetch(const State& w)        extra prefetch of the walk, issued with the degree prefetch
+//   bool move(State& w, Node next)       takes the step to the sampled neighbor next, or rejects it (false)
+//   void end(const State& w, bool dangling)  called once per walker; dangling if it stopped at a node without out-edges
+template <class Walk>
+void Graph::_walk_in_ring(long long walk_count, Walk& walk) const {
+    using State = typename Walk::State;
     struct BufferSlot {
         bool empty_;
-        WalkerMeta w_;
+        State w_;
         int64_t r_;
         Edge suf_;
     };
-    
-    // random_device rd;
-    // mt19937 gen(rd());
-    // uniform_real_distribution<> dist_0_1(0.0, 1.0);
-    // uniform_int_distribution<> dist_int(0, INT_MAX);
-
-    paths.resize(walk_count);
-    for (long long i = 0; i < walk_count; i++) {
-        paths.at(i).push_back(source_id);
-        paths.at(i).reserve((long long)(3/alpha));
-    }
 
     long long next = 0;
     long long num_completed_walkers = 0;
-    int ring_size = 64;
+    const int ring_size = 64;
     BufferSlot r[ring_size];
-
-    int initial_walkers_in_ring = min((long long)ring_size, walk_count);
-    while (next < initial_walkers_in_ring) {
-        r[next].empty_ = false;
-        r[next].w_ = {next, source_id};
-        next++;
-    }
-    for (int i = initial_walkers_in_ring; i < ring_size; ++i) {
-        r[i].empty_ = true;
-    }
+    for (int i = 0; i < ring_size; ++i) r[i].empty_ = true;
 
     while (num_completed_walkers < walk_count) {
         for (int i = 0; i < ring_size; ++i) {
             BufferSlot& slot = r[i];
-            if (!slot.empty_) {
-                // Update the status of the walker.
-                if (rand_0_1(gen) < alpha) {
-                    // If the walker completes, then set the slot as empty.
-                    slot.empty_ = true;
-                    num_completed_walkers += 1;
-                }
+            // Update the status of the walker. If it completes, then set the slot as empty.
+            if (!slot.empty_ && !walk.keep_walking(slot.w_)) {
+                walk.end(slot.w_, false);
+                slot.empty_ = true;
+                num_completed_walkers += 1;
             }
-
-            // If the slot is empty, then add a new walker to the ring buffer.
-            if (slot.empty_) {
-                if (next < walk_count) {
+            // If the slot is empty, then add a new walker, which may complete before its first step.
+            while (slot.empty_ && next < walk_count) {
+                walk.start(next++, slot.w_);
+                if (walk.keep_walking(slot.w_)) {
                     slot.empty_ = false;
-                    slot.w_ = {next++, source_id};
+                } else {
+                    walk.end(slot.w_, false);
+                    num_completed_walkers += 1;
                 }
             }
         }
@@ -121,6 +140,7 @@ void Graph::get_paths_by_thunderRW(Node source_id, double alpha, long long walk_
             if (!slot.empty_) {
                 slot.r_ = rand_int(gen);
                 _mm_prefetch((void*)(start_suf_list.data() + slot.w_.current_), PREFETCH_HINT);
+                walk.prefetch(slot.w_);
             }
         }
 
@@ -130,12 +150,11 @@ void Graph::get_paths_by_thunderRW(Node source_id, double alpha, long long walk_
             if (!slot.empty_) {
                 int degree = start_suf_list[slot.w_.current_ + 1] - start_suf_list[slot.w_.current_];
                 if (degree == 0) {
-                    paths.at(slot.w_.id_).push_back(-1);
+                    walk.end(slot.w_, true);
                     slot.empty_ = true;
                     num_completed_walkers += 1;
                 } else {
-                    slot.r_ = slot.r_ % degree;
-                    slot.suf_ = start_suf_list[slot.w_.current_] + slot.r_;
+                    slot.suf_ = start_suf_list[slot.w_.current_] + slot.r_ % degree;
                     _mm_prefetch((void*)(end_node_list.data() + slot.suf_), PREFETCH_HINT);
                 }
             }
@@ -144,17 +163,138 @@ void Graph::get_paths_by_thunderRW(Node source_id, double alpha, long long walk_
         // Stage 3: update the walker.
         for (int i = 0; i < ring_size; ++i) {
             BufferSlot& slot = r[i];
-            if (!slot.empty_) {
-                slot.w_.current_ = end_node_list[slot.suf_];
-                paths.at(slot.w_.id_).push_back(slot.w_.current_);
-            }
+            if (!slot.empty_) walk.move(slot.w_, end_node_list[slot.suf_]);
         }
-
     }
 
     return;
 }
 
+// Random walks with restart probability alpha, walker i from source_list[i].
+// Walkers of different queries can therefore share one ring.
+// paths[i] is the visited nodes, ending with -1 if the walk reached a node without out-edges.
+void Graph::get_paths_by_thunderRW(const vector<Node>& source_list, double alpha, vector<vector<Node>>& paths) const {
+    struct PathWalk {
+        struct State {
+            long long id_;
+            Node current_;
+        };
+        const Graph& graph;
+        const vector<Node>& source_list;
+        double alpha;
+        vector<vector<Node>>& paths;
+
+        void start(long long id, State& w) {w = {id, source_list[id]};}
+        bool keep_walking(State&) {return graph.rand_0_1(graph.gen) >= alpha;}
+        void prefetch(const State&) {}
+        bool move(State& w, Node next) {
+            w.current_ = next;
+            paths[w.id_].push_back(next);
+            return true;
+        }
+        void end(const State& w, bool dangling) {if (dangling) paths[w.id_].push_back(-1);}
+    };
+
+    const long long walk_count = source_list.size();
+    paths.resize(walk_count);
+    for (long long i = 0; i < walk_count; i++) {
+        paths.at(i).push_back(source_list[i]);
+        paths.at(i).reserve((long long)(3/alpha));
+    }
+    PathWalk walk{*this, source_list, alpha, paths};
+    _walk_in_ring(walk_count, walk);
+}
+
+// Same walks as get_paths_by_thunderRW(source_list, ...), but only the end node of walker i is kept
+// (-1 if it reached a dangling node).
+void Graph::get_endpoints_by_thunderRW(const vector<Node>& source_list, double alpha, vector<Node>& endpoint_list) const {
+    struct EndpointWalk {
+        struct State {
+            long long id_;
+            Node current_;
+        };
+        const Graph& graph;
+        const vector<Node>& source_list;
+        double alpha;
+        vector<Node>& endpoint_list;
+
+        void start(long long id, State& w) {w = {id, source_list[id]};}
+        bool keep_walking(State&) {return graph.rand_0_1(graph.gen) >= alpha;}
+        void prefetch(const State&) {}
+        bool move(State& w, Node next) {
+            w.current_ = next;
+            return true;
+        }
+        void end(const State& w, bool dangling) {endpoint_list[w.id_] = dangling ? -1 : w.current_;}
+    };
+
+    endpoint_list.resize(source_list.size());
+    EndpointWalk walk{*this, source_list, alpha, endpoint_list};
+    _walk_in_ring(source_list.size(), walk);
+}
+
+// Second-order (node2vec) walks of walk_length nodes, one from each node of source_list.
+// The next node x of a walk at current with previous node prev is drawn by rejection sampling:
+// a uniform neighbor x is accepted with probability w(x) / max_w, where w(x) = 1/p if x == prev,
+// 1 if x is adjacent to prev and 1/q otherwise. Adjacency ranges are sorted, so "x is adjacent to prev"
+// is a binary search and no per-edge alias table is needed.
+// With p = q = 1 every candidate is accepted, so neither the search nor the acceptance draw is done.
+// A walk stops early at a node without out-edges (no -1 is appended).
+void Graph::get_paths_by_node2vec(const vector<Node>& source_list, int walk_length, double p, double q, vector<vector<Node>>& paths) const {
+    struct Node2vecWalk {
+        struct State {
+            long long id_;
+            Node prev_;
+            Node current_;
+            int length_;
+        };
+        const Graph& graph;
+        const vector<Node>& source_list;
+        int walk_length;
+        double return_weight;
+        double out_weight;
+        double max_weight;
+        bool uniform;  // p = q = 1
+        vector<vector<Node>>& paths;
+
+        void start(long long id, State& w) {w = {id, -1, source_list[id], 1};}
+        bool keep_walking(State& w) {return w.length_ < walk_length;}
+        // the adjacency range of the previous node is searched when the candidate is checked
+        void prefetch(const State& w) {
+            if (!uniform && w.prev_ != -1) _mm_prefetch((void*)(graph.end_node_list.data() + graph.start_suf_list[w.prev_]), PREFETCH_HINT);
+        }
+        bool move(State& w, Node candidate) {
+            if (!uniform && w.prev_ != -1) {
+                double weight;
+                if (candidate == w.prev_) weight = return_weight;
+                else if (binary_search(graph.end_node_list.begin() + graph.start_suf_list[w.prev_], graph.end_node_list.begin() + graph.start_suf_list[w.prev_ + 1], candidate)) weight = 1;
+                else weight = out_weight;
+                if (graph.rand_0_1(graph.gen) * max_weight >= weight) return false;
+            }
+            paths[w.id_].push_back(candidate);
+            w.prev_ = w.current_;
+            w.current_ = candidate;
+            w.length_++;
+            return true;
+        }
+        void end(const State&, bool) {}
+    };
+    assert(walk_length >= 1 && p > 0 && q > 0);
+    const double return_weight = 1 / p;
+    const double out_weight = 1 / q;
+    const double max_weight = max({return_weight, 1.0, out_weight});
+    const bool uniform = return_weight == 1 && out_weight == 1;
+
+    const long long walk_count = source_list.size();
+    paths.resize(walk_count);
+    for (long long i = 0; i < walk_count; i++) {
+        paths.at(i).reserve(walk_length);
+        paths.at(i).push_back(source_list[i]);
+    }
+    Node2vecWalk walk{*this, source_list, walk_length, return_weight, out_weight, max_weight, uniform, paths};
+    _walk_in_ring(walk_count, walk);
+}
+
 void Graph::get_paths_by_thunderRW_without_prefetch(Node source_id, double alpha, long long walk_count, vector<vector<Node>>& paths) const {
     struct WalkerMeta {
         long long id_;
@@ -263,7 +403,7 @@ void Graph::get_paths_longer_than_1(Node source_id, double alpha, long long walk
             current_node = get_random_adjacent(current_node);
             paths.at(i).push_back(current_node);
             if (current_node == -1) break;
-        } while (rand_0_1(gen) < alpha);
+        } while (rand_0_1(gen) > alpha);
     }
 }
 
@@ -308,6 +448,236 @@ void Graph::calc_ppr_by_fp(const map<Node, double>& src_map, double alpha, long
     return;
 }
 
+// Forward push of FP_LANE_COUNT queries at once, query i with threshold deg / (alpha * walk_count_list[i]).
+// Every touched node holds one residue per query (lane), so each adjacency range is read once for all lanes
+// and the lanes are updated with SSE2. A node is active if any lane exceeds its threshold, and only those lanes
+// are pushed (the other lanes get a zero increment), so each lane follows the push rule of calc_ppr_by_fp.
+// Nodes are mapped to their slot through a dense array, which is reset through the touched nodes after each group.
+// Unlike calc_ppr_by_fp, the mass lost at dangling nodes is not recorded under -1, and the nonzero residues
+// of each query are returned as a list.
+void Graph::calc_ppr_by_fp_batch(const vector<map<Node, double>>& src_map_list, double alpha, const vector<long long>& walk_count_list, vector<vector<pair<Node, double>>>& residue_list, vector<unordered_map<Node, double>>& ppr_list) const {
+    struct alignas(16) Lanes {
+        double val[FP_LANE_COUNT];
+    };
+    static_assert(FP_LANE_COUNT % 2 == 0, "lanes are processed two at a time");
+    assert(walk_count_list.size() == src_map_list.size());
+
+    const size_t query_count = src_map_list.size();
+    residue_list.assign(query_count, {});
+    ppr_list.assign(query_count, {});
+
+    // slot of each node in the current group, -1 if untouched
+    static thread_local vector<long long> slot_of_node;
+    if ((Node)slot_of_node.size() < node_count) slot_of_node.resize(node_count, -1);
+
+    for (size_t first_query = 0; first_query < query_count; first_query += FP_LANE_COUNT) {
+        const int lane_count = min((size_t)FP_LANE_COUNT, query_count - first_query);
+        // threshold of lane l is degree * inv_threshold[l]. Unused lanes keep a zero residue and never pass it.
+        Lanes inv_threshold;
+        for (int l = 0; l < FP_LANE_COUNT; l++) inv_threshold.val[l] = l < lane_count ? 1 / (alpha * walk_count_list[first_query + l]) : 1;
+        vector<Node> slot_node_list;
+        vector<Lanes> residue_lanes, ppr_lanes;
+        vector<char> active_flag_list;
+        queue<size_t> active_slot_queue;
+
+        auto get_slot = [&](Node node_id) {
+            long long& slot = slot_of_node[node_id];
+            if (slot == -1) {
+                slot = slot_node_list.size();
+                slot_node_list.push_back(node_id);
+                residue_lanes.push_back({});
+                ppr_lanes.push_back({});
+                active_flag_list.push_back(false);
+            }
+            return (size_t)slot;
+        };
+        auto activate_if_needed = [&](size_t slot, Node node_id) {
+            if (active_flag_list[slot]) return;
+            const __m128d degree_vec = _mm_set1_pd(get_adj_num(node_id));
+            int over_mask = 0;
+            for (int l = 0; l < FP_LANE_COUNT; l += 2) {
+                __m128d threshold_vec = _mm_mul_pd(degree_vec, _mm_load_pd(inv_threshold.val + l));
+                over_mask |= _mm_movemask_pd(_mm_cmpgt_pd(_mm_load_pd(residue_lanes[slot].val + l), threshold_vec));
+            }
+            if (over_mask != 0) {
+                active_flag_list[slot] = true;
+                active_slot_queue.push(slot);
+            }
+        };
+
+        for (int l = 0; l < lane_count; l++) {
+            for (const auto&[node_id, val] : get_normalized_map(src_map_list[first_query + l])) {
+                residue_lanes[get_slot(node_id)].val[l] += val;
+            }
+        }
+        for (size_t slot = 0; slot < slot_node_list.size(); slot++) activate_if_needed(slot, slot_node_list[slot]);
+
+        const __m128d alpha_vec = _mm_set1_pd(alpha);
+        while (active_slot_queue.size() > 0) {
+            size_t slot = active_slot_queue.front();
+            active_slot_queue.pop();
+            active_flag_list[slot] = false;
+            Node node_id = slot_node_list[slot];
+            int node_degree = get_adj_num(node_id);
+
+            Lanes inc;
+            const __m128d degree_vec = _mm_set1_pd(node_degree);
+            const __m128d spread_vec = _mm_set1_pd(node_degree == 0 ? 0 : (1 - alpha) / node_degree);
+            for (int l = 0; l < FP_LANE_COUNT; l += 2) {
+                __m128d r_vec = _mm_load_pd(residue_lanes[slot].val + l);
+                __m128d over_vec = _mm_cmpgt_pd(r_vec, _mm_mul_pd(degree_vec, _mm_load_pd(inv_threshold.val + l)));
+                __m128d pushed_vec = _mm_and_pd(over_vec, r_vec);
+                _mm_store_pd(ppr_lanes[slot].val + l, _mm_add_pd(_mm_load_pd(ppr_lanes[slot].val + l), _mm_mul_pd(alpha_vec, pushed_vec)));
+                _mm_store_pd(inc.val + l, _mm_mul_pd(spread_vec, pushed_vec));
+                _mm_store_pd(residue_lanes[slot].val + l, _mm_andnot_pd(over_vec, r_vec));
+            }
+
+            for (Edge edge_suf = start_suf_list[node_id]; edge_suf < start_suf_list[node_id + 1]; edge_suf++) {
+                Node adj_id = end_node_list[edge_suf];
+                size_t adj_slot = get_slot(adj_id);
+                double* r = residue_lanes[adj_slot].val;
+                for (int l = 0; l < FP_LANE_COUNT; l += 2) {
+                    _mm_store_pd(r + l, _mm_add_pd(_mm_load_pd(r + l), _mm_load_pd(inc.val + l)));
+                }
+                activate_if_needed(adj_slot, adj_id);
+            }
+        }
+
+        vector<size_t> residue_size_list(lane_count, 0), ppr_size_list(lane_count, 0);
+        for (size_t slot = 0; slot < slot_node_list.size(); slot++) {
+            for (int l = 0; l < lane_count; l++) {
+                residue_size_list[l] += residue_lanes[slot].val[l] != 0;
+                ppr_size_list[l] += ppr_lanes[slot].val[l] != 0;
+            }
+        }
+        for (int l = 0; l < lane_count; l++) {
+            residue_list[first_query + l].reserve(residue_size_list[l]);
+            ppr_list[first_query + l].reserve(ppr_size_list[l]);
+        }
+        for (size_t slot = 0; slot < slot_node_list.size(); slot++) {
+            for (int l = 0; l < lane_count; l++) {
+                if (residue_lanes[slot].val[l] != 0) residue_list[first_query + l].emplace_back(slot_node_list[slot], residue_lanes[slot].val[l]);
+                if (ppr_lanes[slot].val[l] != 0) ppr_list[first_query + l].emplace(slot_node_list[slot], ppr_lanes[slot].val[l]);
+            }
+            slot_of_node[slot_node_list[slot]] = -1;
+        }
+    }
+
+    return;
+}
+
+// calc_ppr_by_fora_thunder for many queries: batched forward push,
+// then the remaining walks of all queries run in one shared ring.
+void Graph::calc_ppr_by_fora_thunder_batch(const vector<map<Node, double>>& src_map_list, double alpha, const vector<long long>& walk_count_list, vector<unordered_map<Node, double>>& ppr_list) const {
+    struct WalkOwner {
+        size_t query_suf;
+        double weight;
+    };
+    vector<vector<pair<Node, double>>> residue_list;
+    calc_ppr_by_fp_batch(src_map_list, alpha, walk_count_list, residue_list, ppr_list);
+
+    vector<Node> source_list;
+    vector<WalkOwner> owner_list;
+    for (size_t q = 0; q < residue_list.size(); q++) {
+        for (const auto&[node_id, r_val] : residue_list[q]) {
+            long long walk_count_i = (long long)ceil(r_val * walk_count_list[q]);
+            source_list.insert(source_list.end(), walk_count_i, node_id);
+            owner_list.insert(owner_list.end(), walk_count_i, {q, r_val / walk_count_i});
+        }
+    }
+
+    vector<Node> endpoint_list;
+    get_endpoints_by_thunderRW(source_list, alpha, endpoint_list);
+    for (size_t i = 0; i < endpoint_list.size(); i++) {
+        if (endpoint_list[i] != -1) ppr_list[owner_list[i].query_suf][endpoint_list[i]] += owner_list[i].weight;
+    }
+}
+
+// Exact ppr (up to tolerance in L1) as a dense vector, for ground truth. Requires the reverse CSR.
+// ppr = sum_t alpha * r_t with r_0 = the normalized src_map and r_t[v] = (1 - alpha) * sum_{u -> v} r_{t-1}[u] / deg(u).
+// Each iteration pulls over the in-neighbors, with the nodes split into thread_count ranges.
+// Mass reaching dangling nodes is dropped, as in the walks.
+void Graph::calc_ppr_by_power_iteration(const map<Node, double>& src_map, double alpha, double tolerance, int thread_count, vector<double>& ppr) const {
+    assert(has_reverse());
+    ppr.assign(node_count, 0);
+    vector<double> current(node_count, 0), next(node_count);
+    for (const auto&[node_id, val] : get_normalized_map(src_map)) current[node_id] = val;
+
+    double remaining_mass = 1;
+    while (remaining_mass > tolerance) {
+        vector<double> mass_list(thread_count, 0);
+        auto iterate = [&](int thread_id) {
+            Node begin = node_count * thread_id / thread_count;
+            Node end = node_count * (thread_id + 1) / thread_count;
+            double mass = 0;
+            for (Node node_id = begin; node_id < end; node_id++) {
+                ppr[node_id] += alpha * current[node_id];
+                double val = 0;
+                for (Edge edge_suf = in_start_suf_list[node_id]; edge_suf < in_start_suf_list[node_id + 1]; edge_suf++) {
+                    Node in_id = in_end_node_list[edge_suf];
+                    val += current[in_id] / (start_suf_list[in_id + 1] - start_suf_list[in_id]);
+                }
+                next[node_id] = (1 - alpha) * val;
+                mass += next[node_id];
+            }
+            mass_list[thread_id] = mass;
+        };
+        vector<thread> threads;
+        for (int t = 1; t < thread_count; t++) threads.emplace_back(iterate, t);
+        iterate(0);
+        for (thread& t : threads) t.join();
+
+        current.swap(next);
+        remaining_mass = 0;
+        for (double mass : mass_list) remaining_mass += mass;
+    }
+}
+
+// Backward push from target_id. Requires the reverse CSR.
+// Afterwards ppr(v, target_id) = reserve[v] + sum_u ppr(v, u) * residue[u] for every v,
+// and every residue is at most r_max, so reserve[v] alone has additive error at most r_max.
+void Graph::calc_ppr_by_bp(Node target_id, double alpha, double r_max, unordered_map<Node, double>& residue, unordered_map<Node, double>& reserve) const {
+    assert(has_reverse());
+    set<Node> active_node_set;
+    queue<Node> active_node_queue;
+    residue[target_id] = 1;
+    if (1 > r_max) {
+        active_node_set.insert(target_id);
+        active_node_queue.push(target_id);
+    }
+
+    while (active_node_queue.size() > 0) {
+        Node node_id = active_node_queue.front();
+        active_node_queue.pop();
+        active_node_set.erase(node_id);
+        double r_val = residue.at(node_id);
+        residue[node_id] = 0;
+        reserve[node_id] += alpha * r_val;
+
+        for (Edge edge_suf = in_start_suf_list[node_id]; edge_suf < in_start_suf_list[node_id + 1]; edge_suf++) {
+            Node in_id = in_end_node_list[edge_suf];
+            double& in_residue = residue[in_id];
+            in_residue += (1 - alpha) * r_val / get_adj_num(in_id);
+            if (in_residue > r_max && active_node_set.count(in_id) == 0) {
+                active_node_set.insert(in_id);
+                active_node_queue.push(in_id);
+            }
+        }
+    }
+
+    return;
+}
+
+// Single-pair ppr(source_id, target_id): backward push on target_id, then walk_count walks from source_id.
+// Each walk adds the residue at its end node to the reserve of source_id.
+double Graph::calc_pair_ppr_by_bidirectional(Node source_id, Node target_id, double alpha, double r_max, long long walk_count) const {
+    unordered_map<Node, double> residue, reserve;
+    calc_ppr_by_bp(target_id, alpha, r_max, residue, reserve);
+    vector<vector<Node>> paths;
+    get_paths_by_thunderRW(source_id, alpha, walk_count, paths);
+    return get_bidirectional_estimate(residue, reserve, source_id, paths);
+}
+
 void Graph::calc_ppr_by_fora_thunder(const map<Node, double>& src_map, double alpha, long long walk_count, unordered_map<Node, double>& ppr) const {
     map<Node, double> normalized_src_map = get_normalized_map(src_map);
     unordered_map<Node, double> residue;
@@ -315,16 +685,20 @@ void Graph::calc_ppr_by_fora_thunder(const map<Node, double>& src_map, double al
     residue.erase(-1);
     ppr.erase(-1);
 
+    long long total_walk_count = 0;
+    for (const auto&[node_id, r_val] : residue) total_walk_count += (long long)ceil(r_val * walk_count);
+    PprAccumulator walk_ppr(node_count, total_walk_count);
     for (const auto&[node_id, r_val] : residue) {
         if (r_val == 0) continue;
         
         long long walk_count_i = (long long)ceil(r_val * walk_count);
         vector<vector<Node>> paths;
         get_paths_by_thunderRW(node_id, alpha, walk_count_i, paths);
-        for (vector<Node> path : paths) {
-            ppr[path.back()] += (double)r_val / walk_count_i;
+        for (const vector<Node>& path : paths) {
+            if (path.back() != -1) walk_ppr.add(path.back(), (double)r_val / walk_count_i);
         }
     }
+    walk_ppr.add_to(ppr);
 }
 
 void Graph::calc_ppr_by_fora_mc(const map<Node, double>& src_map, double alpha, long long walk_count, unordered_map<Node, double>& ppr) const {
@@ -334,16 +708,130 @@ void Graph::calc_ppr_by_fora_mc(const map<Node, double>& src_map, double alpha,
     residue.erase(-1);
     ppr.erase(-1);
 
+    long long total_walk_count = 0;
+    for (const auto&[node_id, r_val] : residue) total_walk_count += (long long)ceil(r_val * walk_count);
+    PprAccumulator walk_ppr(node_count, total_walk_count);
     for (const auto&[node_id, r_val] : residue) {
         if (r_val == 0) continue;
         
         long long walk_count_i = (long long)ceil(r_val * walk_count);
         vector<vector<Node>> paths;
         get_paths_by_mc(node_id, alpha, walk_count_i, paths);
-        for (vector<Node> path : paths) {
-            ppr[path.back()] += (double)r_val / walk_count_i;
+        for (const vector<Node>& path : paths) {
+            if (path.back() != -1) walk_ppr.add(path.back(), (double)r_val / walk_count_i);
         }
     }
+    walk_ppr.add_to(ppr);
+}
+
+// FORA whose remainder stage spends a fixed budget of about walk_count * sum(residue) walks in one stream.
+// Node v first gets floor(r_v * walk_count) walks of weight 1 / walk_count. The fractional parts f_v left over
+// are covered together by ceil(sum f_v) walks whose start nodes are drawn from an alias table over f_v,
+// each of weight sum f_v / (ceil(sum f_v) * walk_count), so the estimate stays unbiased.
+// Unlike ceil(r_v * walk_count) per node, tiny residues do not each cost a whole walk.
+void Graph::calc_ppr_by_fora_alias(const map<Node, double>& src_map, double alpha, long long walk_count, unordered_map<Node, double>& ppr) const {
+    unordered_map<Node, double> residue;
+    calc_ppr_by_fp(src_map, alpha, walk_count, residue, ppr);
+    residue.erase(-1);
+    ppr.erase(-1);
+
+    vector<Node> source_list;
+    vector<Node> frac_node_list;
+    vector<double> frac_list;
+    double frac_sum = 0;
+    for (const auto&[node_id, r_val] : residue) {
+        if (r_val == 0) continue;
+        double scaled = r_val * walk_count;
+        long long whole_count = (long long)scaled;
+        source_list.insert(source_list.end(), whole_count, node_id);
+        if (scaled > whole_count) {
+            frac_node_list.push_back(node_id);
+            frac_list.push_back(scaled - whole_count);
+            frac_sum += scaled - whole_count;
+        }
+    }
+    const long long whole_total = source_list.size();
+    long long frac_walk_count = frac_list.empty() ? 0 : (long long)ceil(frac_sum);
+    if (frac_walk_count > 0) {
+        AliasTable frac_table(frac_list);
+        for (long long i = 0; i < frac_walk_count; i++) source_list.push_back(frac_node_list[frac_table.sample(gen)]);
+    }
+
+    vector<Node> endpoint_list;
+    get_endpoints_by_thunderRW(source_list, alpha, endpoint_list);
+    const double whole_weight = 1.0 / walk_count;
+    const double frac_weight = frac_walk_count > 0 ? frac_sum / (frac_walk_count * (double)walk_count) : 0;
+    PprAccumulator walk_ppr(node_count, endpoint_list.size());
+    for (long long i = 0; i < (long long)endpoint_list.size(); i++) {
+        if (endpoint_list[i] != -1) walk_ppr.add(endpoint_list[i], i < whole_total ? whole_weight : frac_weight);
+    }
+    walk_ppr.add_to(ppr);
+}
+
+// Push, then walks whose start nodes are drawn in proportion to the residues, in rounds of doubling size.
+// The rounds stop as soon as the k-th and (k+1)-th nodes are separated by their confidence bounds
+// (or max_walk_count walks are spent). topk is sorted by score in descending order.
+// The separation is tested once per round, so each test gets fail_prob / (number of rounds) and
+// the returned top-k set is correct with probability at least 1 - fail_prob (union bound).
+void Graph::calc_topk_ppr_by_rounds(const map<Node, double>& src_map, double alpha, int k, long long max_walk_count, double fail_prob, vector<pair<Node, double>>& topk,
+                                    const function<void(const vector<pair<Node, long long>>&, unordered_map<Node, long long>&)>& sample_walks) const {
+    unordered_map<Node, double> residue, push_ppr;
+    calc_ppr_by_fp(src_map, alpha, max_walk_count, residue, push_ppr);
+    residue.erase(-1);
+    push_ppr.erase(-1);
+
+    vector<Node> residue_node_list;
+    vector<double> residue_val_list;
+    double residue_sum = 0;
+    for (const auto&[node_id, r_val] : residue) {
+        if (r_val == 0) continue;
+        residue_node_list.push_back(node_id);
+        residue_val_list.push_back(r_val);
+        residue_sum += r_val;
+    }
+    if (residue_val_list.empty()) {
+        get_topk_if_separated(push_ppr, {}, 0, 0, node_count, k, fail_prob, topk);
+        return;
+    }
+    AliasTable start_table(residue_val_list);
+
+    const long long first_round_walk_count = max(64LL, max_walk_count / 64);
+    int max_round_count = 0;
+    for (long long walk_count = 0, round_walk_count = first_round_walk_count; walk_count < max_walk_count; round_walk_count *= 2) {
+        walk_count += min(round_walk_count, max_walk_count - walk_count);
+        max_round_count++;
+    }
+    const double round_fail_prob = fail_prob / max(max_round_count, 1);
+
+    unordered_map<Node, long long> hit_count_map;
+    long long total_walk_count = 0;
+    long long round_walk_count = first_round_walk_count;
+    while (!get_topk_if_separated(push_ppr, hit_count_map, residue_sum, total_walk_count, node_count, k, round_fail_prob, topk) && total_walk_count < max_walk_count) {
+        round_walk_count = min(round_walk_count, max_walk_count - total_walk_count);
+        vector<long long> start_count_by_suf(residue_node_list.size(), 0);
+        for (long long i = 0; i < round_walk_count; i++) start_count_by_suf[start_table.sample(gen)]++;
+        vector<pair<Node, long long>> start_count_list;
+        for (size_t i = 0; i < residue_node_list.size(); i++) {
+            if (start_count_by_suf[i] > 0) start_count_list.emplace_back(residue_node_list[i], start_count_by_suf[i]);
+        }
+
+        sample_walks(start_count_list, hit_count_map);
+        total_walk_count += round_walk_count;
+        round_walk_count *= 2;
+    }
+}
+
+// Top-k version of calc_ppr_by_fora_thunder. See calc_topk_ppr_by_rounds.
+void Graph::calc_topk_ppr_by_fora_thunder(const map<Node, double>& src_map, double alpha, int k, long long max_walk_count, vector<pair<Node, double>>& topk, double fail_prob) const {
+    calc_topk_ppr_by_rounds(src_map, alpha, k, max_walk_count, fail_prob, topk, [&](const vector<pair<Node, long long>>& start_count_list, unordered_map<Node, long long>& hit_count_map) {
+        vector<Node> source_list;
+        for (const auto&[node_id, start_count] : start_count_list) source_list.insert(source_list.end(), start_count, node_id);
+        vector<Node> endpoint_list;
+        get_endpoints_by_thunderRW(source_list, alpha, endpoint_list);
+        for (Node endpoint : endpoint_list) {
+            if (endpoint != -1) hit_count_map[endpoint]++;
+        }
+    });
 }
 
 void Graph::show_graph() const {
@@ -368,9 +856,68 @@ void Graph::show_graph() const {
     return;
 }
 
+void Graph::_load_attribute() {
+    _read_attribute(data_dir, node_count, is_directed);
+}
+
+FootprintReport Graph::get_footprint() const {
+    FootprintReport report;
+    report.add_array("end_node_list", end_node_list.capacity() * sizeof(Node));
+    report.add_array("start_suf_list", start_suf_list.capacity() * sizeof(Edge));
+    report.add_array("in_end_node_list", in_end_node_list.capacity() * sizeof(Node));
+    report.add_array("in_start_suf_list", in_start_suf_list.capacity() * sizeof(Edge));
+    for (Node node_id = 0; node_id < node_count; node_id++) add_to_log2_histogram(get_adj_num(node_id), report.degree_histogram);
+    return report;
+}
+
+void Graph::scan_degrees(const string& data_dir, vector<int>& degree_list) {
+    long long node_count;
+    bool is_directed;
+    _read_attribute(data_dir, node_count, is_directed);
+    degree_list.assign(node_count, 0);
+
+    ifstream file("./dataset/" + data_dir + "/edges.txt");
+    assert(file.is_open());
+    string line;
+    while (getline(file, line)) {
+        stringstream ss{line};
+        Node src_id, dst_id;
+        if (!(ss >> src_id >> dst_id)) continue;
+        assert(src_id < node_count);
+        assert(dst_id < node_count);
+        if (src_id == dst_id) continue;
+        degree_list[src_id]++;
+        if (!is_directed) degree_list[dst_id]++;
+    }
+}
+
+// A node of map<Node, set<Node>> takes 96 bytes and a node of set<Node> 48 bytes (64-bit glibc malloc).
+FootprintReport Graph::estimate_footprint(const string& data_dir, bool build_reverse, size_t& loader_peak_bytes) {
+    vector<int> degree_list;
+    scan_degrees(data_dir, degree_list);
+    size_t node_count = degree_list.size();
+    size_t edge_count = 0;
+    FootprintReport report;
+    for (int degree : degree_list) {
+        edge_count += degree;
+        add_to_log2_histogram(degree, report.degree_histogram);
+    }
+
+    report.add_array("end_node_list", get_push_back_capacity(edge_count) * sizeof(Node));
+    report.add_array("start_suf_list", get_push_back_capacity(node_count + 1) * sizeof(Edge));
+    if (build_reverse) {
+        report.add_array("in_end_node_list", edge_count * sizeof(Node));
+        report.add_array("in_start_suf_list", (node_count + 1) * sizeof(Edge));
+    }
+    // the reverse CSR and its fill cursors are built while the loader map is still alive
+    size_t loader_map_bytes = node_count * 96 + edge_count * 48;
+    loader_peak_bytes = loader_map_bytes + report.total_bytes + (build_reverse ? node_count * sizeof(Edge) : 0);
+    return report;
+}
+
 // load attribute written in "./dataset/" + data_dir + "/attributes.txt".
 // In Graph, graph needs to be static and unweighted.
-void Graph::_load_attribute() {
+void Graph::_read_attribute(const string& data_dir, long long& node_count, bool& is_directed) {
     ifstream file;
     char splitter = ' ';
     string attribute_file_path = "./dataset/" + data_dir + "/attributes.txt";
@@ -426,13 +973,49 @@ void Graph::_load_edge_from_txt(map<Node, set<Node>> &adj_list_list) {
         assert(dst_id < node_count);
         if (src_id == dst_id) continue; // not accepting self-loop
         
-        adj_list_list[src_id].insert(dst_id);
-        if (!is_directed) adj_list_list[dst_id].insert(src_id);
+        if (is_in_shard(src_id)) adj_list_list[src_id].insert(dst_id);
+        if (!is_directed && is_in_shard(dst_id)) adj_list_list[dst_id].insert(src_id);
     }
     file.close();
     return;
 }
 
+// Vose's construction: slots of weight below the mean are topped up by an alias of weight above it.
+AliasTable::AliasTable(const vector<double>& weight_list) : prob_list(weight_list.size()), alias_list(weight_list.size()) {
+    assert(!weight_list.empty());
+    const size_t n = weight_list.size();
+    double weight_sum = 0;
+    for (double weight : weight_list) weight_sum += weight;
+    assert(weight_sum > 0);
+
+    vector<size_t> small_list, large_list;
+    for (size_t i = 0; i < n; i++) {
+        prob_list[i] = weight_list[i] * n / weight_sum;
+        alias_list[i] = i;
+        if (prob_list[i] < 1) small_list.push_back(i);
+        else large_list.push_back(i);
+    }
+    while (!small_list.empty() && !large_list.empty()) {
+        size_t small = small_list.back(), large = large_list.back();
+        small_list.pop_back();
+        alias_list[small] = large;
+        prob_list[large] -= 1 - prob_list[small];
+        if (prob_list[large] < 1) {
+            large_list.pop_back();
+            small_list.push_back(large);
+        }
+    }
+    // left over only by rounding
+    for (size_t i : small_list) prob_list[i] = 1;
+    for (size_t i : large_list) prob_list[i] = 1;
+}
+
+size_t AliasTable::sample(mt19937& gen) const {
+    double x = uniform_real_distribution<>(0.0, (double)prob_list.size())(gen);
+    size_t i = min((size_t)x, prob_list.size() - 1);
+    return x - i < prob_list[i] ? i : alias_list[i];
+}
+
 map<Node, double> get_normalized_map(const map<long long, double>& input_map) {
     double total_val = 0;
     map<Node, double> normalized_ppr;
@@ -443,4 +1026,116 @@ map<Node, double> get_normalized_map(const map<long long, double>& input_map) {
     }
 
     return normalized_ppr;
+}
+
+// walk_count so that the FORA walk phase has additive error at most epsilon on every node
+// with probability at least 1 - 1/node_count (Hoeffding bound + union bound over nodes).
+long long get_walk_count_for_epsilon(double epsilon, Node node_count) {
+    assert(epsilon > 0);
+    double fail_prob = 1.0 / max(node_count, (Node)2);
+    return (long long)ceil(log(2.0 * node_count / fail_prob) / (2 * epsilon * epsilon));
+}
+
+double get_bidirectional_estimate(const unordered_map<Node, double>& residue, const unordered_map<Node, double>& reserve, Node source_id, const vector<vector<Node>>& paths) {
+    auto reserve_it = reserve.find(source_id);
+    double estimate = reserve_it == reserve.end() ? 0 : reserve_it->second;
+    if (paths.empty()) return estimate;
+    double residue_total = 0;
+    for (const vector<Node>& path : paths) {
+        auto it = residue.find(path.back());
+        if (it != residue.end()) residue_total += it->second;
+    }
+    return estimate + residue_total / paths.size();
+}
+
+// Capacity of a vector filled by push_back up to size elements (libstdc++ doubles from 1).
+size_t get_push_back_capacity(size_t size) {
+    size_t capacity = 1;
+    while (capacity < size) capacity *= 2;
+    return size == 0 ? 0 : capacity;
+}
+
+void add_to_log2_histogram(long long val, vector<long long>& histogram) {
+    size_t bucket = 0;
+    while (val > 0) {
+        val >>= 1;
+        bucket++;
+    }
+    if (histogram.size() <= bucket) histogram.resize(bucket + 1, 0);
+    histogram[bucket]++;
+}
+
+void FootprintReport::print(ostream& os) const {
+    auto print_histogram = [&](const string& name, const vector<long long>& histogram) {
+        os << name << "\n";
+        for (size_t bucket = 0; bucket < histogram.size(); bucket++) {
+            long long low = bucket == 0 ? 0 : 1LL << (bucket - 1);
+            long long high = bucket == 0 ? 0 : (1LL << bucket) - 1;
+            os << "  [" << low << ", " << high << "] " << histogram[bucket] << "\n";
+        }
+    };
+    for (const auto&[name, bytes] : array_bytes_list) os << name << " " << bytes << " bytes\n";
+    os << "total " << total_bytes << " bytes\n";
+    if (path_count > 0) {
+        os << "epoch " << epoch << "\n";
+        os << "paths " << path_count << ", average length " << avg_path_length << "\n";
+        if (build_sec > 0) os << "build " << build_sec << " sec\n";
+        print_histogram("paths per node", paths_per_node_histogram);
+    }
+    if (!degree_histogram.empty()) print_histogram("degree", degree_histogram);
+}
+
+// Current top-k of estimate(v) = push_ppr[v] + residue_sum * hit_count[v] / total_walk_count, sorted in descending order.
+// Returns true if the empirical Bernstein lower bound of the k-th node is not below the upper bound of any other node.
+// The bounds hold for all node_count nodes at once with probability at least 1 - fail_prob,
+// so the top-k set is then correct with that probability.
+bool get_topk_if_separated(const unordered_map<Node, double>& push_ppr, const unordered_map<Node, long long>& hit_count_map, double residue_sum, long long total_walk_count, Node node_count, int k, double fail_prob, vector<pair<Node, double>>& topk) {
+    struct Candidate {
+        Node node_id;
+        double estimate;
+        double bound;
+    };
+    const bool exact = (residue_sum == 0);
+    if (!exact && total_walk_count == 0) {
+        // no walk yet: report the push result only
+        topk.assign(push_ppr.begin(), push_ppr.end());
+        sort(topk.begin(), topk.end(), [](const pair<Node, double>& a, const pair<Node, double>& b) {return a.second > b.second;});
+        if ((int)topk.size() > k) topk.resize(k);
+        return false;
+    }
+
+    unordered_map<Node, double> estimate_map(push_ppr.begin(), push_ppr.end());
+    for (const auto&[node_id, hit_count] : hit_count_map) estimate_map[node_id] += residue_sum * hit_count / total_walk_count;
+
+    // every node of the graph is a candidate, reached or not, so the union bound is over all of them
+    const double log_term = log(3.0 * max((size_t)node_count, estimate_map.size()) / fail_prob);
+    auto get_bound = [&](long long hit_count) {
+        if (exact) return 0.0;
+        double p = (double)hit_count / total_walk_count;
+        return residue_sum * (sqrt(2 * p * (1 - p) * log_term / total_walk_count) + 3 * log_term / total_walk_count);
+    };
+
+    vector<Candidate> candidate_list;
+    candidate_list.reserve(estimate_map.size());
+    for (const auto&[node_id, estimate] : estimate_map) {
+        auto it = hit_count_map.find(node_id);
+        candidate_list.push_back({node_id, estimate, get_bound(it == hit_count_map.end() ? 0 : it->second)});
+    }
+    sort(candidate_list.begin(), candidate_list.end(), [](const Candidate& a, const Candidate& b) {return a.estimate > b.estimate;});
+
+    int topk_size = min((int)candidate_list.size(), k);
+    topk.clear();
+    for (int i = 0; i < topk_size; i++) topk.emplace_back(candidate_list[i].node_id, candidate_list[i].estimate);
+    if (exact) return true;
+
+    // nodes never reached have estimate 0 and the bound of a node with no hit
+    double max_upper_of_rest = get_bound(0);
+    for (size_t i = topk_size; i < candidate_list.size(); i++) {
+        max_upper_of_rest = max(max_upper_of_rest, candidate_list[i].estimate + candidate_list[i].bound);
+    }
+    double min_lower_of_topk = topk_size < k ? 0 : candidate_list[topk_size - 1].estimate - candidate_list[topk_size - 1].bound;
+    for (int i = 0; i < topk_size; i++) {
+        min_lower_of_topk = min(min_lower_of_topk, candidate_list[i].estimate - candidate_list[i].bound);
+    }
+    return min_lower_of_topk >= max_upper_of_rest;
 }
\ No newline at end of file
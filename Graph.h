@@ -13,56 +13,149 @@ using namespace std;
 #include <fstream>
 #include <sstream>
 #include <climits>
+#include <algorithm>
+#include <thread>
+#include <functional>
 #include <emmintrin.h>
 #define PREFETCH_HINT _MM_HINT_T0
 
 using Node = long long;
 using Edge = long long;
 
+// Memory held by a Graph or an Index and the shape of its data. Bytes are capacity * element size of each array.
+// Histograms use log2 buckets: bucket 0 counts the value 0 and bucket i >= 1 counts values in [2^(i-1), 2^i).
+struct FootprintReport {
+    vector<pair<string, size_t>> array_bytes_list;
+    size_t total_bytes = 0;
+    vector<long long> degree_histogram;
+    // Index only
+    long long epoch = 0;
+    long long path_count = 0;
+    double avg_path_length = 0;
+    vector<long long> paths_per_node_histogram;
+    double build_sec = 0;
+
+    void add_array(const string& name, size_t bytes) {
+        array_bytes_list.emplace_back(name, bytes);
+        total_bytes += bytes;
+    }
+    void print(ostream& os) const;
+};
+
 class Graph {
 public:
     using Node = long long;
     using Edge = long long;
+    // number of queries pushed together by calc_ppr_by_fp_batch
+    static constexpr int FP_LANE_COUNT = 8;
     
-    Graph(string data_dir);
+    Graph(string data_dir, bool build_reverse = false);
+    Graph(string data_dir, int shard_id, int shard_count);
     string get_data_dir() const {return data_dir;}
     Node get_node_count() const {return node_count;}
+    Node get_shard_size(int shard_count) const {return (node_count + shard_count - 1) / shard_count;}
+    bool is_in_shard(Node node_id) const {return shard_begin <= node_id && node_id < shard_end;}
+    Node get_shard_begin() const {return shard_begin;}
+    Node get_shard_end() const {return shard_end;}
     int get_adj_num(Node node_id) const {return start_suf_list.at(node_id + 1) - start_suf_list.at(node_id);}
     vector<Node> get_adj_list(Node node_id) const;
+    Node get_adj(Node node_id, int adj_suf) const {return end_node_list[start_suf_list[node_id] + adj_suf];}
+    bool has_reverse() const {return !in_start_suf_list.empty();}
+    int get_in_adj_num(Node node_id) const {return in_start_suf_list.at(node_id + 1) - in_start_suf_list.at(node_id);}
+    vector<Node> get_in_adj_list(Node node_id) const;
     Node get_random_adjacent(Node node_id) const;
     void get_paths_by_mc(Node source_id, double alpha, long long walk_count, vector<vector<Node>>& paths) const;
-    void get_paths_by_thunderRW(Node source_id, double alpha, long long walk_count, vector<vector<Node>>& paths) const;
+    void get_paths_by_thunderRW(Node source_id, double alpha, long long walk_count, vector<vector<Node>>& paths) const {get_paths_by_thunderRW(vector<Node>(walk_count, source_id), alpha, paths);}
+    void get_paths_by_thunderRW(const vector<Node>& source_list, double alpha, vector<vector<Node>>& paths) const;
+    void get_endpoints_by_thunderRW(const vector<Node>& source_list, double alpha, vector<Node>& endpoint_list) const;
+    void get_paths_by_node2vec(const vector<Node>& source_list, int walk_length, double p, double q, vector<vector<Node>>& paths) const;
     void get_paths_by_thunderRW_without_prefetch(Node source_id, double alpha, long long walk_count, vector<vector<Node>>& paths) const;
     void get_paths_longer_than_1(Node source_id, double alpha, long long walk_count, vector<vector<Node>>& paths) const;
     void calc_ppr_by_fp(const map<Node, double>& src_map, double alpha, long long walk_count, unordered_map<Node, double>& residue, unordered_map<Node, double>& ppr) const;
+    void calc_ppr_by_fp_batch(const vector<map<Node, double>>& src_map_list, double alpha, const vector<long long>& walk_count_list, vector<vector<pair<Node, double>>>& residue_list, vector<unordered_map<Node, double>>& ppr_list) const;
+    void calc_ppr_by_fp_batch(const vector<map<Node, double>>& src_map_list, double alpha, long long walk_count, vector<vector<pair<Node, double>>>& residue_list, vector<unordered_map<Node, double>>& ppr_list) const {
+        calc_ppr_by_fp_batch(src_map_list, alpha, vector<long long>(src_map_list.size(), walk_count), residue_list, ppr_list);
+    }
+    void calc_ppr_by_fora_thunder_batch(const vector<map<Node, double>>& src_map_list, double alpha, const vector<long long>& walk_count_list, vector<unordered_map<Node, double>>& ppr_list) const;
+    void calc_ppr_by_fora_thunder_batch(const vector<map<Node, double>>& src_map_list, double alpha, long long walk_count, vector<unordered_map<Node, double>>& ppr_list) const {
+        calc_ppr_by_fora_thunder_batch(src_map_list, alpha, vector<long long>(src_map_list.size(), walk_count), ppr_list);
+    }
+    void calc_ppr_by_power_iteration(const map<Node, double>& src_map, double alpha, double tolerance, int thread_count, vector<double>& ppr) const;
+    void calc_ppr_by_bp(Node target_id, double alpha, double r_max, unordered_map<Node, double>& residue, unordered_map<Node, double>& reserve) const;
+    double calc_pair_ppr_by_bidirectional(Node source_id, Node target_id, double alpha, double r_max, long long walk_count) const;
     void calc_ppr_by_fora_thunder(const map<Node, double>& src_map, double alpha, long long walk_count, unordered_map<Node, double>& ppr) const;
     void calc_ppr_by_fora_thunder(Node src_id, double alpha, long long walk_count, unordered_map<Node, double>& ppr) const {
         map<Node, double> src_map{{src_id, 1}};
         calc_ppr_by_fora_thunder(src_map, alpha, walk_count, ppr);
     }
+    void calc_ppr_by_fora_alias(const map<Node, double>& src_map, double alpha, long long walk_count, unordered_map<Node, double>& ppr) const;
+    void calc_ppr_by_fora_alias(Node src_id, double alpha, long long walk_count, unordered_map<Node, double>& ppr) const {
+        map<Node, double> src_map{{src_id, 1}};
+        calc_ppr_by_fora_alias(src_map, alpha, walk_count, ppr);
+    }
     void calc_ppr_by_fora_mc(const map<Node, double>& src_map, double alpha, long long walk_count, unordered_map<Node, double>& ppr) const;
     void calc_ppr_by_fora_mc(Node src_id, double alpha, long long walk_count, unordered_map<Node, double>& ppr) const {
         map<Node, double> src_map{{src_id, 1}};
         calc_ppr_by_fora_mc(src_map, alpha, walk_count, ppr);
     }
+    // Round loop shared by the top-k FORA variants. sample_walks(start_count_list, hit_count_map) runs start_count walks
+    // from each (node_id, start_count) of the round and counts the end node of every walk that does not end at -1.
+    void calc_topk_ppr_by_rounds(const map<Node, double>& src_map, double alpha, int k, long long max_walk_count, double fail_prob, vector<pair<Node, double>>& topk,
+                                 const function<void(const vector<pair<Node, long long>>&, unordered_map<Node, long long>&)>& sample_walks) const;
+    void calc_topk_ppr_by_fora_thunder(const map<Node, double>& src_map, double alpha, int k, long long max_walk_count, vector<pair<Node, double>>& topk, double fail_prob = 0.01) const;
     void show_graph() const;
+    FootprintReport get_footprint() const;
+    // Out-degrees as the loader would build them, read from edges.txt without building the graph.
+    // Duplicate edges are counted each time, so degrees are upper bounds if edges.txt has any.
+    static void scan_degrees(const string& data_dir, vector<int>& degree_list);
+    // Projected footprint of Graph(data_dir, build_reverse) from scan_degrees. loader_peak_bytes gets the estimated
+    // peak while loading, when the map<Node, set<Node>> of _load_edge_from_txt and the CSR coexist.
+    static FootprintReport estimate_footprint(const string& data_dir, bool build_reverse, size_t& loader_peak_bytes);
 
 private:
     string data_dir;
     long long node_count;
     bool is_directed;
+    // nodes whose out-edges are loaded. [0, node_count) unless loaded as a shard
+    Node shard_begin;
+    Node shard_end;
     vector<Node> end_node_list;
     vector<Edge> start_suf_list;
+    // reverse CSR (in-neighbors), only built with build_reverse
+    vector<Node> in_end_node_list;
+    vector<Edge> in_start_suf_list;
 
-    mutable random_device rd;
-    mutable mt19937 gen;
-    mutable uniform_real_distribution<> rand_0_1;
-    mutable uniform_int_distribution<> rand_int;
+    // generators are per thread so that one Graph can be shared by query workers
+    inline static thread_local random_device rd;
+    inline static thread_local mt19937 gen{rd()};
+    inline static thread_local uniform_real_distribution<> rand_0_1{0.0, 1.0};
+    inline static thread_local uniform_int_distribution<> rand_int{0, INT_MAX};
 
+    template <class Walk>
+    void _walk_in_ring(long long walk_count, Walk& walk) const;
+    void _construct(bool build_reverse);
     void _load_attribute();
+    static void _read_attribute(const string& data_dir, long long& node_count, bool& is_directed);
     void _load_edge_from_txt(map<Node, set<Node>> &adj_list_list);
 };
 
+// Walker's alias method: after O(n) setup, sample() returns i with probability weight_list[i] / sum in O(1).
+class AliasTable {
+public:
+    AliasTable(const vector<double>& weight_list);
+    size_t size() const {return prob_list.size();}
+    size_t sample(mt19937& gen) const;
+
+private:
+    vector<double> prob_list;
+    vector<size_t> alias_list;
+};
+
 map<Node, double> get_normalized_map(const map<long long, double>& input_map);
+long long get_walk_count_for_epsilon(double epsilon, Node node_count);
+double get_bidirectional_estimate(const unordered_map<Node, double>& residue, const unordered_map<Node, double>& reserve, Node source_id, const vector<vector<Node>>& paths);
+size_t get_push_back_capacity(size_t size);
+void add_to_log2_histogram(long long val, vector<long long>& histogram);
+bool get_topk_if_separated(const unordered_map<Node, double>& push_ppr, const unordered_map<Node, long long>& hit_count_map, double residue_sum, long long total_walk_count, Node node_count, int k, double fail_prob, vector<pair<Node, double>>& topk);
 
 #endif
\ No newline at end of file
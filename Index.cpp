@@ -1,34 +1,97 @@
 #include "Index.h"
+#include "PprAccumulator.h"
+#include <chrono>
+
+// Stored paths of an Index snapshot for StoredWalk.
+// The prefetch stages of a ring walker read its referred count, the range of stored paths of its node,
+// and the start and size of the path it joins next, each stage prefetching what the next one reads.
+struct IndexSlices {
+    struct Cursor {
+        int refer_count_of_current_node;
+        int index_size_of_current_node;
+        long long source_start_suf;
+        long long path_start_suf;
+        int path_size;
+    };
+    static constexpr int prefetch_stage_count = 4;
+
+    const IndexStore& store;
+    unordered_map<Node, int>& referred_count_map;
+
+    bool append_next(Node node_id, vector<Node>& path) {
+        int& referred_count = referred_count_map[node_id];
+        long long source_start_suf = store.source_start_suf_list.at(node_id);
+        if (referred_count >= store.source_start_suf_list.at(node_id + 1) - source_start_suf) return false;
+        long long path_id = source_start_suf + referred_count++;
+        path.insert(path.end(), store.node_in_path_list.begin() + store.path_start_suf_list[path_id], store.node_in_path_list.begin() + store.path_start_suf_list[path_id + 1]);
+        return true;
+    }
 
-struct WalkerMeta {
-    long long id_;
-    Node current_;
-    int refer_count_;
-    int current_refer_count;
-};
+    void announce(Node node_id) {}
+
+    void prefetch(int stage, Node node_id, Cursor& cursor) {
+        const vector<long long>& source_start_suf_list = store.source_start_suf_list;
+        const vector<long long>& path_start_suf_list = store.path_start_suf_list;
+        if (stage == 0) {
+            _mm_prefetch((void*)(&referred_count_map[node_id]), PREFETCH_HINT);
+        } else if (stage == 1) {
+            cursor.refer_count_of_current_node = referred_count_map[node_id]++;
+            _mm_prefetch((void*)(source_start_suf_list.data() + node_id), PREFETCH_HINT);
+        } else if (stage == 2) {
+            cursor.source_start_suf = source_start_suf_list[node_id];
+            cursor.index_size_of_current_node = source_start_suf_list[node_id + 1] - cursor.source_start_suf;
+            if (cursor.refer_count_of_current_node < cursor.index_size_of_current_node) {
+                _mm_prefetch((void*)(path_start_suf_list.data() + cursor.source_start_suf + cursor.refer_count_of_current_node), PREFETCH_HINT);
+            }
+        } else if (cursor.refer_count_of_current_node < cursor.index_size_of_current_node) {
+            long long path_id = cursor.source_start_suf + cursor.refer_count_of_current_node;
+            cursor.path_start_suf = path_start_suf_list[path_id];
+            cursor.path_size = path_start_suf_list[path_id + 1] - cursor.path_start_suf;
+            _mm_prefetch((void*)(store.node_in_path_list.data() + cursor.path_start_suf), PREFETCH_HINT);
+        }
+    }
 
-struct BufferSlot {
-    bool empty_;
-    WalkerMeta w_;
-    int refer_count_of_current_node;
-    int index_size_of_current_node;
-    long long source_start_suf;
-    long long path_start_suf;
-    int path_size;
-    int next_path_index;
+    bool append_prefetched(Node node_id, Cursor& cursor, vector<Node>& path) {
+        if (cursor.refer_count_of_current_node >= cursor.index_size_of_current_node) return false;
+        const Node* nodes = store.node_in_path_list.data() + cursor.path_start_suf;
+        path.insert(path.end(), nodes, nodes + cursor.path_size);
+        return true;
+    }
 };
 
-Index::Index(Graph& graph, double alpha_index) : graph(graph), alpha_index(alpha_index) {
-    gen = mt19937(rd());
-    rand_0_1 = uniform_real_distribution<>(0.0, 1.0);
-    rand_int = uniform_int_distribution<>(0, INT_MAX);
+Index::Index(Graph& graph, double alpha_index) : graph(graph), shared(make_shared<IndexShared>(graph.get_node_count())), store(make_shared<IndexStore>()), alpha_index(alpha_index) {
+    atomic_store(&shared->store, store);
+}
+
+// Records how many stored paths the last query consumed, then takes a snapshot of the current store.
+void Index::reset_referred_count_map() {
+    if (store->epoch == atomic_load(&shared->store)->epoch) {
+        for (const auto&[node_id, referred_count] : referred_count_map) {
+            if (node_id == -1) continue;
+            auto initial_it = initial_referred_count_map.find(node_id);
+            int initial_count = initial_it == initial_referred_count_map.end() ? 0 : initial_it->second;
+            long long consumed_count = min(referred_count, _get_index_size_for_node(node_id)) - min(initial_count, _get_index_size_for_node(node_id));
+            if (consumed_count > 0) shared->consumed_count_list[node_id].fetch_add(consumed_count, memory_order_relaxed);
+        }
+    }
+    referred_count_map.clear();
+    initial_referred_count_map.clear();
+    store = atomic_load(&shared->store);
+}
+
+void Index::_publish_store(shared_ptr<IndexStore> new_store) {
+    new_store->epoch = atomic_load(&shared->store)->epoch + 1;
+    atomic_store(&shared->store, shared_ptr<const IndexStore>(new_store));
+    store = new_store;
 }
 
 void Index::generate_index_from_scratch(double size_ratio) {
-    node_in_path_list.clear();
-    path_start_suf_list.clear();
-    source_start_suf_list.clear();
-    
+    auto start = chrono::steady_clock::now();
+    shared_ptr<IndexStore> new_store = make_shared<IndexStore>();
+    vector<Node>& node_in_path_list = new_store->node_in_path_list;
+    vector<long long>& path_start_suf_list = new_store->path_start_suf_list;
+    vector<long long>& source_start_suf_list = new_store->source_start_suf_list;
+
     Node node_count = graph.get_node_count();
     for (Node source_id = 0; source_id < node_count; source_id++) {
         int generate_count = _required_index_size(source_id, size_ratio);
@@ -45,9 +108,15 @@ void Index::generate_index_from_scratch(double size_ratio) {
     }
     source_start_suf_list.push_back((long long)path_start_suf_list.size());
     path_start_suf_list.push_back((long long)node_in_path_list.size());
+    for (atomic<long long>& consumed_count : shared->consumed_count_list) consumed_count.store(0);
+    new_store->build_sec = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    _publish_store(new_store);
 }
 
 void Index::save_index(string file_path) const {
+    const vector<Node>& node_in_path_list = store->node_in_path_list;
+    const vector<long long>& path_start_suf_list = store->path_start_suf_list;
+    const vector<long long>& source_start_suf_list = store->source_start_suf_list;
     std::ofstream ofs(file_path, std::ios::binary);
     if (!ofs) {
         throw std::runtime_error("Failed to open file for writing: " + file_path);
@@ -70,9 +139,10 @@ void Index::save_index(string file_path) const {
 }
 
 void Index::load_index(string file_path) {
-    node_in_path_list.clear();
-    path_start_suf_list.clear();
-    source_start_suf_list.clear();
+    shared_ptr<IndexStore> new_store = make_shared<IndexStore>();
+    vector<Node>& node_in_path_list = new_store->node_in_path_list;
+    vector<long long>& path_start_suf_list = new_store->path_start_suf_list;
+    vector<long long>& source_start_suf_list = new_store->source_start_suf_list;
 
     std::ifstream ifs(file_path, std::ios::binary);
     if (!ifs) {
@@ -96,216 +166,61 @@ void Index::load_index(string file_path) {
     ifs.read(reinterpret_cast<char*>(&source_suf_count), sizeof(size_t));
     source_start_suf_list.resize(source_suf_count);
     ifs.read(reinterpret_cast<char*>(source_start_suf_list.data()), source_suf_count * sizeof(long long));
+    for (atomic<long long>& consumed_count : shared->consumed_count_list) consumed_count.store(0);
+    _publish_store(new_store);
 }
     
-void Index::get(Node source_id, vector<Node>& path) {
-    int referred_count = referred_count_map[source_id];
-
-    if (referred_count < _get_index_size_for_node(source_id)) {
-        long long path_id = source_start_suf_list.at(source_id) + referred_count;
-        long long path_size = path_start_suf_list.at(path_id + 1) - path_start_suf_list.at(path_id);
-        long long path_start_suf = path_start_suf_list.at(path_id);
-        for (long long i = 0; i < path_size; i++) {
-            path.push_back(node_in_path_list.at(path_start_suf + i));
-        }
-        referred_count_map[source_id]++;
-        return;
-    } else {
-        Node current_node_id = source_id;
-        path.push_back(current_node_id);
-        do {
-            if (current_node_id == -1) {
-                break;
-            }
-            if (referred_count_map[current_node_id] < _get_index_size_for_node(current_node_id)) {
-                long long path_id = source_start_suf_list.at(current_node_id) + referred_count_map[current_node_id]++;
-                long long path_size = path_start_suf_list.at(path_id + 1) - path_start_suf_list.at(path_id);
-                long long path_start_suf = path_start_suf_list.at(path_id);
-                path.pop_back();
-                for (long long i = 0; i < path_size; i++) {
-                    path.push_back(node_in_path_list.at(path_start_suf + i));
-                }
-                break;
-            } else {
-                current_node_id = graph.get_random_adjacent(current_node_id);
-                path.push_back(current_node_id);
-                if (current_node_id == -1) break;
-            }
-        } while (rand_0_1(gen) > alpha_index);
-        return;
+shared_ptr<IndexStore> Index::load_store_slice(string file_path, Node node_begin, Node node_end) {
+    shared_ptr<IndexStore> slice = make_shared<IndexStore>();
+    std::ifstream ifs(file_path, std::ios::binary);
+    if (!ifs) {
+        throw std::runtime_error("Failed to open file for reading: " + file_path);
+    }
+    // the three lists follow each other, each after its size
+    size_t node_count, path_suf_count, source_suf_count;
+    ifs.read(reinterpret_cast<char*>(&node_count), sizeof(size_t));
+    const streamoff path_suf_offset = sizeof(size_t) + node_count * sizeof(Node);
+    ifs.seekg(path_suf_offset);
+    ifs.read(reinterpret_cast<char*>(&path_suf_count), sizeof(size_t));
+    const streamoff source_suf_offset = path_suf_offset + sizeof(size_t) + path_suf_count * sizeof(long long);
+    ifs.seekg(source_suf_offset);
+    ifs.read(reinterpret_cast<char*>(&source_suf_count), sizeof(size_t));
+    if (!ifs || node_begin < 0 || node_begin > node_end || (size_t)node_end >= source_suf_count) {
+        throw std::runtime_error("Index file does not cover the node range: " + file_path);
     }
-    
-}
 
-void Index::get(Node source_id, int max_len, vector<Node>& path) {
-    int current_path_size = 0;
-
-    if (referred_count_map[source_id] < _get_index_size_for_node(source_id)) {
-        long long path_id = source_start_suf_list.at(source_id) + referred_count_map[source_id]++;
-        long long path_size = path_start_suf_list.at(path_id + 1) - path_start_suf_list.at(path_id);
-        long long path_start_suf = path_start_suf_list.at(path_id);
-        for (long long i = 0; i < path_size; i++) {
-            path.push_back(node_in_path_list.at(path_start_suf + i));
-            current_path_size++;
-            if (current_path_size >= max_len) return;
-        }
-        return;
-    } else {
-        Node current_node_id = source_id;
-        path.push_back(current_node_id);
-        current_path_size++;
-        do {
-            if (current_node_id == -1) {
-                break;
-            }
-            if (referred_count_map[current_node_id] < _get_index_size_for_node(current_node_id)) {
-                long long path_id = source_start_suf_list.at(current_node_id) + referred_count_map[current_node_id]++;
-                long long path_size = path_start_suf_list.at(path_id + 1) - path_start_suf_list.at(path_id);
-                long long path_start_suf = path_start_suf_list.at(path_id);
-                path.pop_back();
-                for (long long i = 0; i < path_size; i++) {
-                    path.push_back(node_in_path_list.at(path_start_suf + i));
-                    current_path_size++;
-                    if (current_path_size >= max_len) break;
-                }
-                break;
-            } else {
-                current_node_id = graph.get_random_adjacent(current_node_id);
-                path.push_back(current_node_id);
-                current_path_size++;
-                if (current_node_id == -1 || current_path_size >= max_len) break;
-            }
-        } while (rand_0_1(gen) > alpha_index);
-        return;
+    // each list is read over the range of the previous one and rebased to start at 0
+    auto read_range = [&](streamoff list_offset, long long begin, long long end, auto& list) {
+        list.resize(end - begin);
+        ifs.seekg(list_offset + sizeof(size_t) + begin * sizeof(list[0]));
+        ifs.read(reinterpret_cast<char*>(list.data()), list.size() * sizeof(list[0]));
+    };
+    read_range(source_suf_offset, node_begin, node_end + 1, slice->source_start_suf_list);
+    const long long path_begin = slice->source_start_suf_list.front();
+    read_range(path_suf_offset, path_begin, slice->source_start_suf_list.back() + 1, slice->path_start_suf_list);
+    const long long node_in_path_begin = slice->path_start_suf_list.front();
+    read_range(0, node_in_path_begin, slice->path_start_suf_list.back(), slice->node_in_path_list);
+    if (!ifs) {
+        throw std::runtime_error("Failed to read index file: " + file_path);
     }
+    for (long long& source_start_suf : slice->source_start_suf_list) source_start_suf -= path_begin;
+    for (long long& path_start_suf : slice->path_start_suf_list) path_start_suf -= node_in_path_begin;
+    return slice;
 }
 
-void Index::_get_paths(Node source_id, long long walk_count, double alpha, vector<vector<Node>>& paths) {
-    paths.resize(walk_count);
-
-    binomial_distribution<> bin_dist(walk_count, alpha);
-    default_random_engine engine(seed_gen());
-    const long long length_1_count = bin_dist(engine);
-
-    if (alpha < alpha_index) {
-        long long completed_walker_count = 0;
-        const double accept_prob = alpha / alpha_index;
-        GeometricDistribution geo_dist_downscale(accept_prob);
-
-        vector<WalkerMeta> walkers;
-        for (long long i = 0; i < walk_count - length_1_count; i++) {
-            int refer_count = geo_dist_downscale.get() + 1;
-            get(source_id, paths.at(i));
-            if (refer_count >= 2) {
-                walkers.push_back({i, paths.at(i).back(), refer_count, 1});
-            } else completed_walker_count++;
-        }
-
-        BufferSlot ring[ring_size];
-        long long walkers_next_suf = 0;
-        long long walkers_size = walkers.size();
-        for (int i = 0; i < ring_size; ++i) {
-            if (walkers_next_suf < walkers_size) {
-                ring[i].empty_ = false;
-                ring[i].w_ = walkers[walkers_next_suf++];
-            } else {
-                ring[i].empty_ = true;
-            }
-        }
-
-        while (completed_walker_count < walk_count - length_1_count) {
-            // Stage 1: prefetch referred count.
-            for (int i = 0; i < ring_size; ++i) {
-                BufferSlot& slot = ring[i];
-                if (!slot.empty_) {
-                    if (slot.w_.current_ == -1) {
-                        slot.empty_ = true;
-                        completed_walker_count++;
-                    } else {   
-                        _mm_prefetch((void*)(&referred_count_map[slot.w_.current_]), PREFETCH_HINT);
-                    }
-                }
-            }
-
-            // Stage 2: prefetch index size.
-            for (int i = 0; i < ring_size; ++i) {
-                BufferSlot& slot = ring[i];
-                if (!slot.empty_) {
-                    slot.refer_count_of_current_node = referred_count_map[slot.w_.current_]++;
-                    _mm_prefetch((void*)(source_start_suf_list.data() + slot.w_.current_), PREFETCH_HINT);
-                }
-            }
-
-            // Stage 3: prefetch suffix in node_in_path_list.
-            for (int i = 0; i < ring_size; ++i) {
-                BufferSlot& slot = ring[i];
-                if (!slot.empty_) {
-                    slot.source_start_suf = source_start_suf_list[slot.w_.current_];
-                    slot.index_size_of_current_node = source_start_suf_list[slot.w_.current_ + 1] - source_start_suf_list[slot.w_.current_]; 
-                    if (slot.refer_count_of_current_node < slot.index_size_of_current_node) {
-                        _mm_prefetch((void*)(path_start_suf_list.data() + source_start_suf_list[slot.w_.current_] + slot.refer_count_of_current_node), PREFETCH_HINT);
-                    }
-                }
-            }
-
-            // Stage 4: prefetch path.
-            for (int i = 0; i < ring_size; ++i) {
-                BufferSlot& slot = ring[i];
-                if (!slot.empty_) {
-                    if (slot.refer_count_of_current_node < slot.index_size_of_current_node) {
-                        slot.path_start_suf = path_start_suf_list[slot.source_start_suf + slot.refer_count_of_current_node]; 
-                        slot.path_size = path_start_suf_list[slot.source_start_suf + slot.refer_count_of_current_node + 1] - path_start_suf_list[slot.source_start_suf + slot.refer_count_of_current_node];
-                        _mm_prefetch((void*)(node_in_path_list.data() + slot.path_start_suf), PREFETCH_HINT);
-                    }
-                }
-            }
+void Index::get(Node source_id, vector<Node>& path) {
+    IndexSlices slices{*store, referred_count_map};
+    StoredWalk<IndexSlices>(graph, alpha_index, slices).get(source_id, path);
+}
 
-            // Stage 5: update the walker.
-            for (int i = 0; i < ring_size; ++i) {
-                BufferSlot& slot = ring[i];
-                if (!slot.empty_) {
-                    paths.at(slot.w_.id_).pop_back();
-
-                    if (slot.refer_count_of_current_node < slot.index_size_of_current_node) {
-                        for (int j = 0; j < slot.path_size; j++) {
-                            paths.at(slot.w_.id_).push_back(node_in_path_list[slot.path_start_suf + j]);
-                        }
-                    } else {
-                        get(slot.w_.current_, paths.at(slot.w_.id_));
-                    }
-                    
-                    slot.w_.current_refer_count++;
-                    if (slot.w_.current_refer_count >= slot.w_.refer_count_) {
-                        slot.empty_ = true;
-                        completed_walker_count++;
-                    } else {
-                        slot.w_.current_ = paths.at(slot.w_.id_).back();
-                    }
-                }
-
-                if (slot.empty_) {
-                    if (walkers_next_suf < walkers_size) {
-                        slot.empty_ = false;
-                        slot.w_ = walkers[walkers_next_suf++];
-                    }
-                }
-            }
-        }
-    } else if (alpha > alpha_index) {
-        const double terminate_prob = (alpha - alpha_index) / (1 - alpha_index);
-        GeometricDistribution geo_dist_upscale(terminate_prob);
-        
-        for (long long i = 0; i < walk_count - length_1_count; i++) {
-            int max_len = geo_dist_upscale.get() + 2;
-            get(source_id, max_len, paths.at(i));
-        }
-    } else {
-        for (long long i = 0; i < walk_count - length_1_count; i++) get(source_id, paths.at(i));
-    }
-    
-    for (long long i = walk_count - length_1_count; i < walk_count; i++) paths.at(i).push_back(source_id);
+void Index::get(Node source_id, int max_len, vector<Node>& path) {
+    IndexSlices slices{*store, referred_count_map};
+    StoredWalk<IndexSlices>(graph, alpha_index, slices).get(source_id, max_len, path);
+}
 
-    return;
+void Index::_get_paths(Node source_id, long long walk_count, double alpha, vector<vector<Node>>& paths, bool enable_thunder) {
+    IndexSlices slices{*store, referred_count_map};
+    StoredWalk<IndexSlices>(graph, alpha_index, slices).get_paths(source_id, walk_count, alpha, paths, enable_thunder, ring_size);
 }
 
 void Index::calc_ppr_by_fora_plus(const map<Node, double>& src_map, double alpha, long long walk_count, unordered_map<Node, double>& ppr, bool enable_thunder) {
@@ -316,21 +231,121 @@ void Index::calc_ppr_by_fora_plus(const map<Node, double>& src_map, double alpha
     graph.calc_ppr_by_fp(src_map, alpha, walk_count, residue, ppr);
     residue.erase(-1);
     ppr.erase(-1);
+    _calc_walk_ppr(residue, alpha, walk_count, ppr, enable_thunder);
+}
+
+// Walk phase of calc_ppr_by_fora_plus: ceil(r * walk_count) walks from every node with residue r,
+// each adding r / (its walk count) to ppr at its end node.
+void Index::calc_walk_ppr_by_fora_plus(const unordered_map<Node, double>& residue, double alpha, long long walk_count, unordered_map<Node, double>& ppr, bool enable_thunder) {
+    assert(alpha > 0 && alpha <= 1);
+    reset_referred_count_map();
+    _calc_walk_ppr(residue, alpha, walk_count, ppr, enable_thunder);
+}
+
+bool Index::continue_walk_ppr_by_fora_plus(const unordered_map<Node, double>& residue, double alpha, long long walk_count, long long epoch, vector<pair<Node, int>>& referred_count_list, unordered_map<Node, double>& ppr, bool enable_thunder) {
+    assert(alpha > 0 && alpha <= 1);
+    reset_referred_count_map();
+    if (store->epoch != epoch) return false;
+    referred_count_map.insert(referred_count_list.begin(), referred_count_list.end());
+    initial_referred_count_map = referred_count_map;
+    _calc_walk_ppr(residue, alpha, walk_count, ppr, enable_thunder);
+    referred_count_list.clear();
+    for (const auto&[node_id, referred_count] : referred_count_map) {
+        if (referred_count > 0) referred_count_list.emplace_back(node_id, referred_count);
+    }
+    return true;
+}
 
+void Index::_calc_walk_ppr(const unordered_map<Node, double>& residue, double alpha, long long walk_count, unordered_map<Node, double>& ppr, bool enable_thunder) {
+    long long total_walk_count = 0;
+    for (const auto&[node_id, r_val] : residue) total_walk_count += (long long)ceil(r_val * walk_count);
+    PprAccumulator walk_ppr(graph.get_node_count(), total_walk_count);
     for (const auto&[node_id, r_val] : residue) {
         if (r_val == 0) continue;
         
         long long walk_count_i = (long long)ceil(r_val * walk_count);
         vector<vector<Node>> paths;
-        _get_paths(node_id, walk_count_i, alpha, paths);
+        _get_paths(node_id, walk_count_i, alpha, paths, enable_thunder);
         
-        for (vector<Node> path : paths) {
-            ppr[path.back()] += (double)r_val / walk_count_i;
+        for (const vector<Node>& path : paths) {
+            if (path.back() != -1) walk_ppr.add(path.back(), (double)r_val / walk_count_i);
+        }
+    }
+    walk_ppr.add_to(ppr);
+}
+
+// Graph::calc_pair_ppr_by_bidirectional with the walks from source_id taken from the index.
+double Index::calc_pair_ppr_by_bidirectional(Node source_id, Node target_id, double alpha, double r_max, long long walk_count) {
+    assert(alpha > 0 && alpha <= 1);
+    reset_referred_count_map();
+    unordered_map<Node, double> residue, reserve;
+    graph.calc_ppr_by_bp(target_id, alpha, r_max, residue, reserve);
+    vector<vector<Node>> paths;
+    _get_paths(source_id, walk_count, alpha, paths);
+    return get_bidirectional_estimate(residue, reserve, source_id, paths);
+}
+
+// Top-k version of calc_ppr_by_fora_plus. See Graph::calc_topk_ppr_by_rounds.
+// Referred counts are kept across rounds, so stored paths are not reused within one query.
+void Index::calc_topk_ppr_by_fora_plus(const map<Node, double>& src_map, double alpha, int k, long long max_walk_count, vector<pair<Node, double>>& topk, double fail_prob) {
+    assert(alpha > 0 && alpha <= 1);
+    reset_referred_count_map();
+    graph.calc_topk_ppr_by_rounds(src_map, alpha, k, max_walk_count, fail_prob, topk, [&](const vector<pair<Node, long long>>& start_count_list, unordered_map<Node, long long>& hit_count_map) {
+        for (const auto&[node_id, start_count] : start_count_list) {
+            vector<vector<Node>> paths;
+            _get_paths(node_id, start_count, alpha, paths);
+            for (const vector<Node>& path : paths) {
+                if (path.back() != -1) hit_count_map[path.back()]++;
+            }
         }
+    });
+}
+
+FootprintReport Index::get_footprint() const {
+    shared_ptr<const IndexStore> current = atomic_load(&shared->store);
+    FootprintReport report;
+    report.add_array("node_in_path_list", current->node_in_path_list.capacity() * sizeof(Node));
+    report.add_array("path_start_suf_list", current->path_start_suf_list.capacity() * sizeof(long long));
+    report.add_array("source_start_suf_list", current->source_start_suf_list.capacity() * sizeof(long long));
+    report.add_array("consumed_count_list", shared->consumed_count_list.size() * sizeof(atomic<long long>));
+    report.epoch = current->epoch;
+    report.build_sec = current->build_sec;
+    if (current->source_start_suf_list.empty()) return report;
+
+    report.path_count = current->path_start_suf_list.size() - 1;
+    if (report.path_count > 0) report.avg_path_length = (double)current->node_in_path_list.size() / report.path_count;
+    for (Node node_id = 0; node_id + 1 < (Node)current->source_start_suf_list.size(); node_id++) {
+        add_to_log2_histogram(current->source_start_suf_list[node_id + 1] - current->source_start_suf_list[node_id], report.paths_per_node_histogram);
+    }
+    return report;
+}
+
+// A stored path is the source plus 1 + Geometric(alpha_index) steps (Graph::get_paths_longer_than_1),
+// 1 + 1 / alpha_index nodes on average.
+FootprintReport Index::estimate_footprint(const string& data_dir, double alpha_index, double size_ratio, double sec_per_stored_node) {
+    vector<int> degree_list;
+    Graph::scan_degrees(data_dir, degree_list);
+    FootprintReport report;
+    for (int degree : degree_list) {
+        long long path_count = ceil(size_ratio * degree / alpha_index);
+        report.path_count += path_count;
+        add_to_log2_histogram(path_count, report.paths_per_node_histogram);
+        add_to_log2_histogram(degree, report.degree_histogram);
     }
+    report.avg_path_length = 1 + 1 / alpha_index;
+    size_t stored_node_count = report.path_count * report.avg_path_length;
+    report.add_array("node_in_path_list", get_push_back_capacity(stored_node_count) * sizeof(Node));
+    report.add_array("path_start_suf_list", get_push_back_capacity(report.path_count + 1) * sizeof(long long));
+    report.add_array("source_start_suf_list", get_push_back_capacity(degree_list.size() + 1) * sizeof(long long));
+    report.add_array("consumed_count_list", degree_list.size() * sizeof(atomic<long long>));
+    report.build_sec = stored_node_count * sec_per_stored_node;
+    return report;
 }
 
 void Index::show_index() const {
+    const vector<Node>& node_in_path_list = store->node_in_path_list;
+    const vector<long long>& path_start_suf_list = store->path_start_suf_list;
+    const vector<long long>& source_start_suf_list = store->source_start_suf_list;
     // cout << "node_in_path_list" << endl;
     // for (Node node_id : node_in_path_list) {
     //     cout << node_id << " ";
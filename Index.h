@@ -2,6 +2,8 @@
 #define INDEX_H_
 #define PREFETCH_HINT _MM_HINT_T0
 #include "Graph.h"
+#include <memory>
+#include <atomic>
 // #include <emmintrin.h>
 // #define NDEBUG
 using namespace std;
@@ -18,11 +20,190 @@ public:
 
 private:
     double coef;
-    inline static std::random_device rd;
-    inline static std::mt19937 mt{rd()};
-    inline static std::uniform_real_distribution<double> dist{0.0, 1.0};
+    inline static thread_local std::random_device rd;
+    inline static thread_local std::mt19937 mt{rd()};
+    inline static thread_local std::uniform_real_distribution<double> dist{0.0, 1.0};
 };
 
+// Walks assembled from stored paths, shared by Index and PagedIndex.
+// Slices gives access to the stored paths of each node and counts the ones a query has read:
+//   bool append_next(Node node_id, vector<Node>& path)
+//       appends the next unread stored path of node_id, false if all of them have been read
+//   void announce(Node node_id)
+//       called when the next node of a ring walker is known, a full ring pass before it is read
+//   static constexpr int prefetch_stage_count, struct Cursor, void prefetch(int stage, Node node_id, Cursor& cursor)
+//       the ring runs each stage over all of its walkers before the next one, so a stage can prefetch what the next reads
+//   bool append_prefetched(Node node_id, Cursor& cursor, vector<Node>& path)
+//       append_next after the prefetch stages
+template <class Slices>
+class StoredWalk {
+public:
+    StoredWalk(Graph& graph, double alpha_index, Slices& slices) : graph(graph), alpha_index(alpha_index), slices(slices) {}
+
+    // The next stored path of source_id or, once they are used up, a walk with stop probability alpha_index
+    // that joins the stored path of the first node on its way that has one left.
+    void get(Node source_id, vector<Node>& path) {
+        if (slices.append_next(source_id, path)) return;
+        Node current_node_id = source_id;
+        path.push_back(current_node_id);
+        do {
+            current_node_id = graph.get_random_adjacent(current_node_id);
+            path.push_back(current_node_id);
+        } while (current_node_id != -1 && rand_0_1(gen) > alpha_index && !_join_stored_path(path));
+    }
+
+    // get(source_id, path) cut to at most max_len nodes.
+    void get(Node source_id, int max_len, vector<Node>& path) {
+        const size_t start_size = path.size();
+        if (!slices.append_next(source_id, path)) {
+            Node current_node_id = source_id;
+            path.push_back(current_node_id);
+            do {
+                current_node_id = graph.get_random_adjacent(current_node_id);
+                path.push_back(current_node_id);
+            } while (current_node_id != -1 && path.size() - start_size < (size_t)max_len && rand_0_1(gen) > alpha_index && !_join_stored_path(path));
+        }
+        if (path.size() - start_size > (size_t)max_len) path.resize(start_size + max_len);
+    }
+
+    // walk_count walks from source_id with stop probability alpha, made from walks with stop probability alpha_index.
+    // alpha < alpha_index: a walk joins Geometric(alpha / alpha_index) of them, end to end. The walkers take turns
+    //                      in a ring of ring_size slots (enable_thunder) so that the stored paths they read next
+    //                      are prefetched, or else join theirs one after another.
+    // alpha > alpha_index: a walk is cut to 1 + Geometric((alpha - alpha_index) / (1 - alpha_index)) steps.
+    // A Binomial(walk_count, alpha) number of the walks stop at source_id right away.
+    void get_paths(Node source_id, long long walk_count, double alpha, vector<vector<Node>>& paths, bool enable_thunder, int ring_size) {
+        paths.resize(walk_count);
+
+        binomial_distribution<> bin_dist(walk_count, alpha);
+        default_random_engine engine(seed_gen());
+        const long long length_1_count = bin_dist(engine);
+
+        if (alpha < alpha_index) {
+            GeometricDistribution geo_dist_downscale(alpha / alpha_index);
+            vector<Walker> walkers;
+            for (long long i = 0; i < walk_count - length_1_count; i++) {
+                int refer_count = geo_dist_downscale.get() + 1;
+                get(source_id, paths.at(i));
+                if (refer_count >= 2 && paths.at(i).back() != -1) walkers.push_back({i, paths.at(i).back(), refer_count, 1});
+            }
+            if (enable_thunder) _run_ring(walkers, paths, ring_size);
+            else {
+                for (Walker& walker : walkers) {
+                    vector<Node>& path = paths.at(walker.id_);
+                    for (; walker.current_refer_count < walker.refer_count_ && path.back() != -1; walker.current_refer_count++) {
+                        Node current_node_id = path.back();
+                        path.pop_back();
+                        get(current_node_id, path);
+                    }
+                }
+            }
+        } else if (alpha > alpha_index) {
+            GeometricDistribution geo_dist_upscale((alpha - alpha_index) / (1 - alpha_index));
+            for (long long i = 0; i < walk_count - length_1_count; i++) {
+                int max_len = geo_dist_upscale.get() + 2;
+                get(source_id, max_len, paths.at(i));
+            }
+        } else {
+            for (long long i = 0; i < walk_count - length_1_count; i++) get(source_id, paths.at(i));
+        }
+
+        for (long long i = walk_count - length_1_count; i < walk_count; i++) paths.at(i).push_back(source_id);
+    }
+
+private:
+    struct Walker {
+        long long id_;
+        Node current_;
+        int refer_count_;
+        int current_refer_count;
+    };
+    struct Slot {
+        bool empty_;
+        Walker w_;
+        typename Slices::Cursor cursor;
+    };
+
+    Graph& graph;
+    double alpha_index;
+    Slices& slices;
+
+    inline static thread_local random_device seed_gen;
+    inline static thread_local mt19937 gen{seed_gen()};
+    inline static thread_local uniform_real_distribution<> rand_0_1{0.0, 1.0};
+
+    // Replaces the last node of path by its next stored path. Returns false and leaves path as it is if none is left.
+    bool _join_stored_path(vector<Node>& path) {
+        Node node_id = path.back();
+        path.pop_back();
+        if (slices.append_next(node_id, path)) return true;
+        path.push_back(node_id);
+        return false;
+    }
+
+    // Every walker ends with a node other than -1 and has joined 1 of its refer_count_ >= 2 paths.
+    void _run_ring(const vector<Walker>& walkers, vector<vector<Node>>& paths, int ring_size) {
+        vector<Slot> ring(ring_size);
+        size_t walkers_next_suf = 0;
+        size_t completed_walker_count = 0;
+        auto refill = [&](Slot& slot) {
+            slot.empty_ = walkers_next_suf >= walkers.size();
+            if (!slot.empty_) {
+                slot.w_ = walkers[walkers_next_suf++];
+                slices.announce(slot.w_.current_);
+            }
+        };
+        for (Slot& slot : ring) refill(slot);
+
+        while (completed_walker_count < walkers.size()) {
+            for (int stage = 0; stage < Slices::prefetch_stage_count; stage++) {
+                for (Slot& slot : ring) {
+                    if (!slot.empty_) slices.prefetch(stage, slot.w_.current_, slot.cursor);
+                }
+            }
+
+            for (Slot& slot : ring) {
+                if (slot.empty_) continue;
+                vector<Node>& path = paths.at(slot.w_.id_);
+                path.pop_back();
+                if (!slices.append_prefetched(slot.w_.current_, slot.cursor, path)) get(slot.w_.current_, path);
+
+                slot.w_.current_refer_count++;
+                slot.w_.current_ = path.back();
+                if (slot.w_.current_refer_count >= slot.w_.refer_count_ || slot.w_.current_ == -1) {
+                    completed_walker_count++;
+                    refill(slot);
+                } else slices.announce(slot.w_.current_);
+            }
+        }
+    }
+};
+
+// Stored paths of an index. Immutable once built, so it is shared by all copies of an Index.
+// A refresh publishes a new IndexStore with the next epoch instead of modifying this one.
+// A slice of it (Index::load_store_slice) holds the paths of one node range only.
+struct IndexStore {
+    vector<Node> node_in_path_list;
+    vector<long long> path_start_suf_list;
+    vector<long long> source_start_suf_list;
+    long long epoch = 0;
+    // wall time of generate_index_from_scratch, 0 if the paths were loaded or re-sampled
+    double build_sec = 0;
+};
+
+// State shared by all copies of an Index.
+struct IndexShared {
+    IndexShared(Node node_count) : consumed_count_list(node_count) {}
+    // current store. Accessed with atomic_load / atomic_store only.
+    shared_ptr<const IndexStore> store;
+    // stored paths of each source consumed by queries since they were last re-sampled
+    vector<atomic<long long>> consumed_count_list;
+};
+
+// A copy of Index shares the stored paths and only owns its referred counts,
+// so each query thread can work on its own copy.
+// Every query takes a snapshot of the current store when it starts (reset_referred_count_map),
+// so a store swapped in by IndexRefresher is only seen by later queries.
 class Index {
 public:
     using Node = Graph::Node;
@@ -30,11 +211,17 @@ public:
     Index(Graph& graph, double alpha_index);
     double get_alpha_index() const {return alpha_index;}
     unordered_map<Node, int> get_referred_count_map() const {return referred_count_map;}
-    void reset_referred_count_map() {referred_count_map.clear();}
+    long long get_epoch() const {return atomic_load(&shared->store)->epoch;}
+    // epoch of the snapshot the last query of this copy ran on
+    long long get_snapshot_epoch() const {return store->epoch;}
+    void reset_referred_count_map();
     
     void generate_index_from_scratch(double size_ratio);
     void save_index(string file_path) const;
     void load_index(string file_path);
+    // Stored paths of the sources in [node_begin, node_end) from a file written by save_index, reading only
+    // that part of the file. Entry i of source_start_suf_list belongs to node node_begin + i.
+    static shared_ptr<IndexStore> load_store_slice(string file_path, Node node_begin, Node node_end);
     void get(Node source_id, vector<Node>& path);
     void get(Node source_id, int max_len, vector<Node>& path);
     // void get_paths_without_prefetch(Node source_id, long long walk_count, double alpha, vector<vector<Node>>& paths);
@@ -43,24 +230,38 @@ public:
         _get_paths(source_id, walk_count, alpha, paths);
     }
     void calc_ppr_by_fora_plus(const map<Node, double>& src_map, double alpha, long long walk_count, unordered_map<Node, double>& ppr, bool enable_thunder);
+    void calc_walk_ppr_by_fora_plus(const unordered_map<Node, double>& residue, double alpha, long long walk_count, unordered_map<Node, double>& ppr, bool enable_thunder);
+    // calc_walk_ppr_by_fora_plus continuing an earlier walk phase that ran on the store of epoch and left the
+    // referred counts referred_count_list. The stored paths the earlier walks read are skipped, so the new walks
+    // are independent of them. referred_count_list is updated to the counts after the new walks.
+    // Returns false without running any walk if the current store is no longer the one of epoch.
+    bool continue_walk_ppr_by_fora_plus(const unordered_map<Node, double>& residue, double alpha, long long walk_count, long long epoch, vector<pair<Node, int>>& referred_count_list, unordered_map<Node, double>& ppr, bool enable_thunder);
+    double calc_pair_ppr_by_bidirectional(Node source_id, Node target_id, double alpha, double r_max, long long walk_count);
+    void calc_topk_ppr_by_fora_plus(const map<Node, double>& src_map, double alpha, int k, long long max_walk_count, vector<pair<Node, double>>& topk, double fail_prob = 0.01);
     // void calc_ppr_by_fora_plus_with_thunder(const map<Node, double>& src_map, double alpha, long long walk_count, unordered_map<Node, double>& ppr);
     void show_index() const;
+    // Footprint of the current store (not the snapshot of this copy), taken from a single snapshot of it.
+    FootprintReport get_footprint() const;
+    // Projected footprint and build time of generate_index_from_scratch(size_ratio) from Graph::scan_degrees.
+    // Paths are counted exactly. Their lengths are taken as expected, ignoring paths cut short at dangling nodes,
+    // so the projection is an upper bound. sec_per_stored_node can be calibrated from an earlier build.
+    static FootprintReport estimate_footprint(const string& data_dir, double alpha_index, double size_ratio, double sec_per_stored_node = 1e-7);
 
 private:
+    friend class IndexRefresher;
+
     Graph& graph;
-    vector<Node> node_in_path_list;
-    vector<long long> path_start_suf_list;
-    vector<long long> source_start_suf_list;
+    shared_ptr<IndexShared> shared;
+    shared_ptr<const IndexStore> store;
     unordered_map<Node, int> referred_count_map;
+    // referred counts the last query started from, which were already counted as consumed
+    unordered_map<Node, int> initial_referred_count_map;
 
-    mutable random_device rd;
-    mutable mt19937 gen;
-    mutable uniform_real_distribution<> rand_0_1;
-    mutable uniform_int_distribution<> rand_int;
-
-    int _get_index_size_for_node(Node node_id) const {return source_start_suf_list.at(node_id + 1) - source_start_suf_list.at(node_id);}
+    int _get_index_size_for_node(Node node_id) const {return store->source_start_suf_list.at(node_id + 1) - store->source_start_suf_list.at(node_id);}
     int _required_index_size(Node src_id, double size_ratio) const {return ceil(size_ratio * graph.get_adj_num(src_id) / alpha_index);}
-    void _get_paths(Node source_id, long long walk_count, double alpha, vector<vector<Node>>& paths);
+    void _get_paths(Node source_id, long long walk_count, double alpha, vector<vector<Node>>& paths, bool enable_thunder = true);
+    void _publish_store(shared_ptr<IndexStore> new_store);
+    void _calc_walk_ppr(const unordered_map<Node, double>& residue, double alpha, long long walk_count, unordered_map<Node, double>& ppr, bool enable_thunder);
     // void _get_paths_with_thunder(Node source_id, long long walk_count, double alpha, vector<vector<Node>>& paths);
     // void _get_paths_samescale(Node source_id, long long walk_count, double alpha, vector<vector<Node>>& paths);
     // void _get_paths_upscale(Node source_id, long long walk_count, double alpha, vector<vector<Node>>& paths, GeometricDistribution& geo_dist);
@@ -70,7 +271,6 @@ private:
     // vector<vector<vector<int>>> node_to_path_list;
     int index_size;
     double alpha_index;
-    random_device seed_gen;
     int ring_size=64;
 };
 
@@ -0,0 +1,113 @@
+#include "IndexRefresher.h"
+#include <chrono>
+
+IndexRefresher::IndexRefresher(Index& index, double cpu_budget, int thread_count, long long max_source_count)
+    : index(index), cpu_budget(cpu_budget), thread_count(thread_count), max_source_count(max_source_count) {
+    assert(cpu_budget > 0 && cpu_budget <= 1);
+    assert(thread_count >= 1);
+}
+
+void IndexRefresher::start() {
+    if (refresher.joinable()) return;
+    stop_requested = false;
+    refresher = thread(&IndexRefresher::_run, this);
+}
+
+void IndexRefresher::stop() {
+    {
+        lock_guard<mutex> lock(stop_mutex);
+        stop_requested = true;
+    }
+    stop_cv.notify_all();
+    if (refresher.joinable()) refresher.join();
+}
+
+// Must not run concurrently with generate_index_from_scratch / load_index.
+long long IndexRefresher::refresh_once() {
+    IndexShared& shared = *index.shared;
+    shared_ptr<const IndexStore> old_store = atomic_load(&shared.store);
+    const Node node_count = index.graph.get_node_count();
+    if (old_store->source_start_suf_list.empty()) return 0;
+
+    // sources with the most consumed paths first
+    vector<pair<long long, Node>> consumed_list;
+    for (Node node_id = 0; node_id < node_count; node_id++) {
+        long long consumed_count = shared.consumed_count_list[node_id].load(memory_order_relaxed);
+        if (consumed_count > 0) consumed_list.emplace_back(consumed_count, node_id);
+    }
+    if (consumed_list.empty()) return 0;
+    if ((long long)consumed_list.size() > max_source_count) {
+        nth_element(consumed_list.begin(), consumed_list.begin() + max_source_count, consumed_list.end(), greater<pair<long long, Node>>());
+        consumed_list.resize(max_source_count);
+    }
+    sort(consumed_list.begin(), consumed_list.end(), [](const pair<long long, Node>& a, const pair<long long, Node>& b) {return a.second < b.second;});
+
+    // re-sample the consumed prefix of each slice
+    vector<vector<vector<Node>>> new_paths_list(consumed_list.size());
+    for (auto&[consumed_count, node_id] : consumed_list) {
+        long long index_size = old_store->source_start_suf_list[node_id + 1] - old_store->source_start_suf_list[node_id];
+        consumed_count = min(shared.consumed_count_list[node_id].exchange(0), index_size);
+    }
+    auto sample = [&](int thread_id) {
+        for (size_t i = thread_id; i < consumed_list.size(); i += thread_count) {
+            index.graph.get_paths_longer_than_1(consumed_list[i].second, index.alpha_index, consumed_list[i].first, new_paths_list[i]);
+        }
+    };
+    vector<thread> samplers;
+    for (int t = 1; t < thread_count; t++) samplers.emplace_back(sample, t);
+    sample(0);
+    for (thread& t : samplers) t.join();
+
+    // build the shadow store: refreshed paths first, then the untouched rest of each slice
+    shared_ptr<IndexStore> new_store = make_shared<IndexStore>();
+    vector<Node>& node_in_path_list = new_store->node_in_path_list;
+    vector<long long>& path_start_suf_list = new_store->path_start_suf_list;
+    vector<long long>& source_start_suf_list = new_store->source_start_suf_list;
+    node_in_path_list.reserve(old_store->node_in_path_list.size());
+    path_start_suf_list.reserve(old_store->path_start_suf_list.size());
+    source_start_suf_list.reserve(old_store->source_start_suf_list.size());
+
+    size_t refreshed_suf = 0;
+    long long path_count = 0;
+    for (Node source_id = 0; source_id < node_count; source_id++) {
+        source_start_suf_list.push_back((long long)path_start_suf_list.size());
+        long long first_kept_path = old_store->source_start_suf_list[source_id];
+        if (refreshed_suf < consumed_list.size() && consumed_list[refreshed_suf].second == source_id) {
+            for (const vector<Node>& path : new_paths_list[refreshed_suf]) {
+                path_start_suf_list.push_back((long long)node_in_path_list.size());
+                node_in_path_list.insert(node_in_path_list.end(), path.begin(), path.end());
+            }
+            first_kept_path += consumed_list[refreshed_suf].first;
+            path_count += consumed_list[refreshed_suf].first;
+            refreshed_suf++;
+        }
+        for (long long path_id = first_kept_path; path_id < old_store->source_start_suf_list[source_id + 1]; path_id++) {
+            path_start_suf_list.push_back((long long)node_in_path_list.size());
+            node_in_path_list.insert(node_in_path_list.end(),
+                old_store->node_in_path_list.begin() + old_store->path_start_suf_list[path_id],
+                old_store->node_in_path_list.begin() + old_store->path_start_suf_list[path_id + 1]);
+        }
+    }
+    source_start_suf_list.push_back((long long)path_start_suf_list.size());
+    path_start_suf_list.push_back((long long)node_in_path_list.size());
+
+    index._publish_store(new_store);
+    refreshed_path_count += path_count;
+    return consumed_list.size();
+}
+
+void IndexRefresher::_run() {
+    const chrono::duration<double> idle_interval(0.1);
+    while (true) {
+        auto begin = chrono::steady_clock::now();
+        long long refreshed_source_count = refresh_once();
+        chrono::duration<double> work = chrono::steady_clock::now() - begin;
+
+        // sleep so that the average CPU use stays within cpu_budget
+        chrono::duration<double> sleep = work * thread_count / cpu_budget - work;
+        if (refreshed_source_count == 0) sleep = max(sleep, idle_interval);
+
+        unique_lock<mutex> lock(stop_mutex);
+        if (stop_cv.wait_for(lock, sleep, [this] {return stop_requested;})) return;
+    }
+}
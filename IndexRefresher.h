@@ -0,0 +1,44 @@
+#ifndef INDEX_REFRESHER_H_
+#define INDEX_REFRESHER_H_
+#include "Index.h"
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+// Keeps an Index fresh while it is being queried.
+// Queries read the stored paths of a source from the start of its slice, so the consumed prefix of a slice
+// is what the next query would reuse. Each refresh takes the sources with the most consumed paths,
+// re-samples their consumed prefixes on worker threads into a shadow IndexStore,
+// and publishes it as the next epoch. Queries running on the old epoch keep it alive until they finish.
+//
+// cpu_budget is the fraction of one core the refresher may use on average (0, 1].
+// The shadow store is a full copy: every refresh copies all stored paths, not only the re-sampled slices,
+// so a round costs O(index size) time, counted against cpu_budget, and holds a second copy of the index in memory
+// until queries on the old epoch finish. With a small budget, rounds on a large index are far apart.
+class IndexRefresher {
+public:
+    IndexRefresher(Index& index, double cpu_budget, int thread_count = 1, long long max_source_count = 4096);
+    ~IndexRefresher() {stop();}
+
+    void start();
+    void stop();
+    // Re-sample once and publish the new epoch. Returns the number of re-sampled sources.
+    long long refresh_once();
+    long long get_refreshed_path_count() const {return refreshed_path_count;}
+
+private:
+    Index index;
+    double cpu_budget;
+    int thread_count;
+    long long max_source_count;
+    atomic<long long> refreshed_path_count{0};
+
+    thread refresher;
+    bool stop_requested = false;
+    mutex stop_mutex;
+    condition_variable stop_cv;
+
+    void _run();
+};
+
+#endif
@@ -0,0 +1,333 @@
+#include "PagedIndex.h"
+#include "PprAccumulator.h"
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char PAGED_INDEX_MAGIC[4] = {'A', 'F', 'W', 'P'};
+static const uint32_t PAGED_INDEX_VERSION = 1;
+static const long long PAGED_INDEX_HEADER_BYTES = sizeof(PAGED_INDEX_MAGIC) + sizeof(uint32_t) + sizeof(int64_t);
+
+static void read_at(int fd, void* buf, size_t size, long long offset) {
+    char* p = static_cast<char*>(buf);
+    while (size > 0) {
+        ssize_t n = pread(fd, p, size, offset);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) throw std::runtime_error("Failed to read paged index");
+        p += n;
+        size -= n;
+        offset += n;
+    }
+}
+
+IndexPagePool::IndexPagePool(string file_path, size_t capacity_bytes, Node page_source_count, int readahead_thread_count, int shard_count)
+    : page_source_count(page_source_count) {
+    assert(page_source_count > 0 && shard_count > 0);
+    file.fd = open(file_path.c_str(), O_RDONLY);
+    if (file.fd < 0) {
+        throw std::runtime_error("Failed to open file for reading: " + file_path);
+    }
+    struct stat file_stat;
+    fstat(file.fd, &file_stat);
+
+    char magic[4];
+    uint32_t version;
+    int64_t file_node_count, directory_offset;
+    read_at(file.fd, magic, sizeof(magic), 0);
+    read_at(file.fd, &version, sizeof(version), sizeof(magic));
+    read_at(file.fd, &file_node_count, sizeof(file_node_count), sizeof(magic) + sizeof(version));
+    if (memcmp(magic, PAGED_INDEX_MAGIC, sizeof(magic)) != 0 || version != PAGED_INDEX_VERSION) {
+        throw std::runtime_error("Not a paged index file: " + file_path);
+    }
+    node_count = file_node_count;
+    read_at(file.fd, &directory_offset, sizeof(directory_offset), file_stat.st_size - sizeof(directory_offset));
+
+    source_offset_list.resize(node_count + 1);
+    path_count_list.resize(node_count);
+    read_at(file.fd, source_offset_list.data(), source_offset_list.size() * sizeof(long long), directory_offset);
+    read_at(file.fd, path_count_list.data(), path_count_list.size() * sizeof(long long), directory_offset + source_offset_list.size() * sizeof(long long));
+
+    for (int i = 0; i < shard_count; i++) {
+        shard_list.push_back(make_unique<Shard>());
+        shard_list.back()->capacity_bytes = capacity_bytes / shard_count;
+    }
+    for (int i = 0; i < readahead_thread_count; i++) readahead_threads.emplace_back(&IndexPagePool::_run_readahead, this);
+}
+
+IndexPagePool::~IndexPagePool() {
+    {
+        lock_guard<mutex> lock(readahead_mutex);
+        stop_requested = true;
+    }
+    readahead_cv.notify_all();
+    for (thread& t : readahead_threads) t.join();
+}
+
+shared_ptr<const IndexPage> IndexPagePool::get(long long page_id) {
+    Shard& shard = _get_shard(page_id);
+    unique_lock<mutex> lock(shard.shard_mutex);
+    while (true) {
+        auto it = shard.frame_map.find(page_id);
+        if (it == shard.frame_map.end()) break;
+        if (!it->second.loading) {
+            it->second.referenced = true;
+            hit_count.fetch_add(1, memory_order_relaxed);
+            return it->second.page;
+        }
+        shard.loaded_cv.wait(lock);
+    }
+
+    miss_count.fetch_add(1, memory_order_relaxed);
+    _insert_loading_frame(shard, page_id);
+    lock.unlock();
+    shared_ptr<IndexPage> page;
+    try {
+        page = _read_page(page_id);
+    } catch (...) {
+        lock.lock();
+        _finish_loading(shard, page_id, nullptr);
+        throw;
+    }
+    lock.lock();
+    _finish_loading(shard, page_id, page);
+    return page;
+}
+
+void IndexPagePool::readahead(long long page_id) {
+    lock_guard<mutex> queue_lock(readahead_mutex);
+    if (readahead_threads.empty() || readahead_queue.size() >= max_readahead_queue_size) return;
+    Shard& shard = _get_shard(page_id);
+    {
+        lock_guard<mutex> lock(shard.shard_mutex);
+        if (shard.frame_map.count(page_id) > 0) return;
+        _insert_loading_frame(shard, page_id);
+    }
+    readahead_queue.push_back(page_id);
+    readahead_count.fetch_add(1, memory_order_relaxed);
+    readahead_cv.notify_one();
+}
+
+size_t IndexPagePool::_get_page_bytes(long long page_id) const {
+    Node first_source = page_id * page_source_count;
+    Node last_source = min(first_source + page_source_count, node_count);
+    return source_offset_list[last_source] - source_offset_list[first_source];
+}
+
+// shard_mutex must be held.
+void IndexPagePool::_insert_loading_frame(Shard& shard, long long page_id) {
+    size_t bytes = _get_page_bytes(page_id);
+    _make_room(shard, bytes);
+    size_t clock_suf;
+    if (!shard.free_clock_suf_list.empty()) {
+        clock_suf = shard.free_clock_suf_list.back();
+        shard.free_clock_suf_list.pop_back();
+        shard.clock_list[clock_suf] = page_id;
+    } else {
+        clock_suf = shard.clock_list.size();
+        shard.clock_list.push_back(page_id);
+    }
+    shard.frame_map[page_id] = {nullptr, true, true, bytes, clock_suf};
+    shard.used_bytes += bytes;
+}
+
+// CLOCK: clear the reference bit of referenced frames and evict the first unreferenced one,
+// until bytes fit. Frames being read are never evicted. shard_mutex must be held.
+void IndexPagePool::_make_room(Shard& shard, size_t bytes) {
+    size_t scanned_count = 0;
+    while (shard.used_bytes + bytes > shard.capacity_bytes && scanned_count < 2 * shard.clock_list.size()) {
+        if (shard.clock_hand >= shard.clock_list.size()) shard.clock_hand = 0;
+        long long page_id = shard.clock_list[shard.clock_hand];
+        if (page_id != -1) {
+            Frame& frame = shard.frame_map.at(page_id);
+            if (frame.referenced) {
+                frame.referenced = false;
+            } else if (!frame.loading) {
+                shard.used_bytes -= frame.bytes;
+                shard.frame_map.erase(page_id);
+                shard.clock_list[shard.clock_hand] = -1;
+                shard.free_clock_suf_list.push_back(shard.clock_hand);
+            }
+        }
+        shard.clock_hand++;
+        scanned_count++;
+    }
+}
+
+shared_ptr<IndexPage> IndexPagePool::_read_page(long long page_id) const {
+    shared_ptr<IndexPage> page = make_shared<IndexPage>();
+    page->data.resize(_get_page_bytes(page_id) / sizeof(Node));
+    read_at(file.fd, page->data.data(), page->data.size() * sizeof(Node), source_offset_list[page_id * page_source_count]);
+    return page;
+}
+
+// Publishes a read page, or drops the frame if the read failed (page == nullptr). shard_mutex must be held.
+void IndexPagePool::_finish_loading(Shard& shard, long long page_id, shared_ptr<IndexPage> page) {
+    Frame& frame = shard.frame_map.at(page_id);
+    if (page) {
+        frame.page = page;
+        frame.loading = false;
+    } else {
+        shard.used_bytes -= frame.bytes;
+        shard.clock_list[frame.clock_suf] = -1;
+        shard.free_clock_suf_list.push_back(frame.clock_suf);
+        shard.frame_map.erase(page_id);
+    }
+    shard.loaded_cv.notify_all();
+}
+
+void IndexPagePool::_run_readahead() {
+    while (true) {
+        long long page_id;
+        {
+            unique_lock<mutex> queue_lock(readahead_mutex);
+            readahead_cv.wait(queue_lock, [this] {return stop_requested || !readahead_queue.empty();});
+            if (stop_requested) return;
+            page_id = readahead_queue.front();
+            readahead_queue.pop_front();
+        }
+
+        shared_ptr<IndexPage> page;
+        try {
+            page = _read_page(page_id);
+        } catch (const std::runtime_error&) {
+            // get() reads the page again and reports the error
+        }
+        Shard& shard = _get_shard(page_id);
+        lock_guard<mutex> lock(shard.shard_mutex);
+        _finish_loading(shard, page_id, page);
+    }
+}
+
+PagedIndex::PagedIndex(Graph& graph, double alpha_index, string file_path, size_t cache_bytes, Node page_source_count, int readahead_thread_count)
+    : graph(graph), alpha_index(alpha_index), pool(make_shared<IndexPagePool>(file_path, cache_bytes, page_source_count, readahead_thread_count)) {
+    assert(pool->get_node_count() == graph.get_node_count());
+}
+
+// Same paths as Index::generate_index_from_scratch, written block by block.
+// At most about buffer_bytes of paths are held in memory besides the directory.
+void PagedIndex::generate_index_to_file(Graph& graph, double alpha_index, double size_ratio, string file_path, size_t buffer_bytes) {
+    std::ofstream ofs(file_path, std::ios::binary);
+    if (!ofs) {
+        throw std::runtime_error("Failed to open file for writing: " + file_path);
+    }
+    const int64_t node_count = graph.get_node_count();
+    ofs.write(PAGED_INDEX_MAGIC, sizeof(PAGED_INDEX_MAGIC));
+    ofs.write(reinterpret_cast<const char*>(&PAGED_INDEX_VERSION), sizeof(PAGED_INDEX_VERSION));
+    ofs.write(reinterpret_cast<const char*>(&node_count), sizeof(node_count));
+
+    vector<long long> source_offset_list;
+    vector<long long> path_count_list;
+    source_offset_list.reserve(node_count + 1);
+    path_count_list.reserve(node_count);
+    vector<Node> buffer;
+    long long offset = PAGED_INDEX_HEADER_BYTES;
+
+    auto flush = [&]() {
+        ofs.write(reinterpret_cast<const char*>(buffer.data()), buffer.size() * sizeof(Node));
+        buffer.clear();
+    };
+
+    for (Node source_id = 0; source_id < node_count; source_id++) {
+        int generate_count = ceil(size_ratio * graph.get_adj_num(source_id) / alpha_index);
+        vector<vector<Node>> path_list;
+        graph.get_paths_longer_than_1(source_id, alpha_index, generate_count, path_list);
+
+        size_t block_start = buffer.size();
+        buffer.push_back(path_list.size());
+        long long path_end_suf = 0;
+        for (const vector<Node>& path : path_list) {
+            path_end_suf += path.size();
+            buffer.push_back(path_end_suf);
+        }
+        for (const vector<Node>& path : path_list) buffer.insert(buffer.end(), path.begin(), path.end());
+
+        source_offset_list.push_back(offset);
+        path_count_list.push_back(path_list.size());
+        offset += (buffer.size() - block_start) * sizeof(Node);
+        if (buffer.size() * sizeof(Node) >= buffer_bytes) flush();
+    }
+    flush();
+    source_offset_list.push_back(offset);
+
+    const int64_t directory_offset = offset;
+    ofs.write(reinterpret_cast<const char*>(source_offset_list.data()), source_offset_list.size() * sizeof(long long));
+    ofs.write(reinterpret_cast<const char*>(path_count_list.data()), path_count_list.size() * sizeof(long long));
+    ofs.write(reinterpret_cast<const char*>(&directory_offset), sizeof(directory_offset));
+    if (!ofs) {
+        throw std::runtime_error("Failed to write paged index: " + file_path);
+    }
+}
+
+// Stored paths of a PagedIndex for StoredWalk. The page of the node a ring walker moves to is read ahead as soon
+// as the node is known, and read when the walker comes round again a full ring pass later.
+struct PagedSlices {
+    struct Cursor {};
+    static constexpr int prefetch_stage_count = 0;
+
+    IndexPagePool& pool;
+    unordered_map<Node, int>& referred_count_map;
+
+    bool append_next(Node node_id, vector<Node>& path) {
+        int& referred_count = referred_count_map[node_id];
+        if (referred_count >= pool.get_path_count(node_id)) return false;
+
+        shared_ptr<const IndexPage> page = pool.get(node_id / pool.get_page_source_count());
+        const Node* block = page->data.data() + pool.get_block_suf_in_page(node_id);
+        const long long path_count = block[0];
+        const Node* path_end_suf_list = block + 1;
+        const Node* nodes = block + 1 + path_count;
+        long long path_start_suf = referred_count == 0 ? 0 : path_end_suf_list[referred_count - 1];
+        path.insert(path.end(), nodes + path_start_suf, nodes + path_end_suf_list[referred_count]);
+        referred_count++;
+        return true;
+    }
+
+    void announce(Node node_id) {
+        if (referred_count_map[node_id] < pool.get_path_count(node_id)) pool.readahead(node_id / pool.get_page_source_count());
+    }
+
+    void prefetch(int stage, Node node_id, Cursor& cursor) {}
+
+    bool append_prefetched(Node node_id, Cursor& cursor, vector<Node>& path) {return append_next(node_id, path);}
+};
+
+void PagedIndex::get(Node source_id, vector<Node>& path) {
+    PagedSlices slices{*pool, referred_count_map};
+    StoredWalk<PagedSlices>(graph, alpha_index, slices).get(source_id, path);
+}
+
+void PagedIndex::get(Node source_id, int max_len, vector<Node>& path) {
+    PagedSlices slices{*pool, referred_count_map};
+    StoredWalk<PagedSlices>(graph, alpha_index, slices).get(source_id, max_len, path);
+}
+
+void PagedIndex::_get_paths(Node source_id, long long walk_count, double alpha, vector<vector<Node>>& paths) {
+    PagedSlices slices{*pool, referred_count_map};
+    StoredWalk<PagedSlices>(graph, alpha_index, slices).get_paths(source_id, walk_count, alpha, paths, true, ring_size);
+}
+
+// Same as Index::calc_ppr_by_fora_plus.
+void PagedIndex::calc_ppr_by_fora_plus(const map<Node, double>& src_map, double alpha, long long walk_count, unordered_map<Node, double>& ppr) {
+    assert(alpha > 0 && alpha <= 1);
+    reset_referred_count_map();
+    unordered_map<Node, double> residue;
+    graph.calc_ppr_by_fp(src_map, alpha, walk_count, residue, ppr);
+    residue.erase(-1);
+    ppr.erase(-1);
+
+    long long total_walk_count = 0;
+    for (const auto&[node_id, r_val] : residue) total_walk_count += (long long)ceil(r_val * walk_count);
+    PprAccumulator walk_ppr(graph.get_node_count(), total_walk_count);
+    for (const auto&[node_id, r_val] : residue) {
+        if (r_val == 0) continue;
+
+        long long walk_count_i = (long long)ceil(r_val * walk_count);
+        vector<vector<Node>> paths;
+        _get_paths(node_id, walk_count_i, alpha, paths);
+        for (const vector<Node>& path : paths) {
+            if (path.back() != -1) walk_ppr.add(path.back(), (double)r_val / walk_count_i);
+        }
+    }
+    walk_ppr.add_to(ppr);
+}
@@ -0,0 +1,136 @@
+#ifndef PAGED_INDEX_H_
+#define PAGED_INDEX_H_
+#include "Index.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unistd.h>
+
+// Index kept on disk for indexes larger than RAM.
+//
+// file format (written by PagedIndex::generate_index_to_file)
+//   header    : "AFWP" , uint32 version , int64 node_count
+//   blocks    : one block per source, in source order
+//               int64 path_count , path_count * int64 path_end_suf , nodes of all paths
+//               (path i is nodes[path_end_suf[i - 1], path_end_suf[i]), path_end_suf[-1] = 0)
+//   directory : (node_count + 1) * int64 byte offset of each block , node_count * int64 path_count
+//   trailer   : int64 byte offset of the directory
+//
+// The blocks of page_source_count consecutive sources form one page, which is the unit of
+// reading and caching in IndexPagePool.
+
+struct IndexPage {
+    vector<Node> data;
+};
+
+// Buffer pool of pages with CLOCK eviction and asynchronous readahead. Shared by all copies of a PagedIndex.
+// Pages are spread over shard_count shards by page id. Each shard has its own lock, frames, clock and
+// capacity_bytes / shard_count of the budget, so query threads hitting different pages do not contend.
+class IndexPagePool {
+public:
+    IndexPagePool(string file_path, size_t capacity_bytes, Node page_source_count, int readahead_thread_count, int shard_count = 16);
+    ~IndexPagePool();
+
+    Node get_node_count() const {return node_count;}
+    Node get_page_source_count() const {return page_source_count;}
+    long long get_path_count(Node node_id) const {return path_count_list[node_id];}
+    // Offset of the block of node_id inside the data of its page, in Nodes.
+    long long get_block_suf_in_page(Node node_id) const {
+        return (source_offset_list[node_id] - source_offset_list[node_id / page_source_count * page_source_count]) / sizeof(Node);
+    }
+
+    // Returns the page, reading it if needed. Blocks while it is being read.
+    shared_ptr<const IndexPage> get(long long page_id);
+    // Starts reading the page in the background if it is not cached. Never blocks on I/O.
+    void readahead(long long page_id);
+
+    long long get_hit_count() const {return hit_count;}
+    long long get_miss_count() const {return miss_count;}
+    long long get_readahead_count() const {return readahead_count;}
+
+private:
+    struct Frame {
+        shared_ptr<const IndexPage> page;
+        bool loading;
+        bool referenced;
+        size_t bytes;
+        size_t clock_suf;
+    };
+    struct Shard {
+        mutex shard_mutex;
+        condition_variable loaded_cv;
+        size_t capacity_bytes;
+        size_t used_bytes = 0;
+        unordered_map<long long, Frame> frame_map;
+        vector<long long> clock_list;   // page id per clock slot, -1 for a free slot
+        vector<size_t> free_clock_suf_list;
+        size_t clock_hand = 0;
+    };
+    // Closes the file when the pool is destroyed or its constructor throws.
+    struct FileDescriptor {
+        int fd = -1;
+        ~FileDescriptor() {if (fd >= 0) close(fd);}
+    };
+
+    FileDescriptor file;
+    Node node_count;
+    Node page_source_count;
+    vector<long long> source_offset_list;
+    vector<long long> path_count_list;
+
+    vector<unique_ptr<Shard>> shard_list;
+
+    // lock order: readahead_mutex before shard_mutex
+    mutex readahead_mutex;
+    deque<long long> readahead_queue;
+    size_t max_readahead_queue_size = 256;
+    condition_variable readahead_cv;
+    vector<thread> readahead_threads;
+    bool stop_requested = false;
+
+    atomic<long long> hit_count{0};
+    atomic<long long> miss_count{0};
+    atomic<long long> readahead_count{0};
+
+    Shard& _get_shard(long long page_id) {return *shard_list[page_id % shard_list.size()];}
+    size_t _get_page_bytes(long long page_id) const;
+    void _insert_loading_frame(Shard& shard, long long page_id);
+    void _make_room(Shard& shard, size_t bytes);
+    shared_ptr<IndexPage> _read_page(long long page_id) const;
+    void _finish_loading(Shard& shard, long long page_id, shared_ptr<IndexPage> page);
+    void _run_readahead();
+};
+
+// Same queries as Index on an index file, paging the stored paths through an IndexPagePool.
+// Like Index, a copy shares the pool and owns its referred counts, so each query thread can use its own copy.
+class PagedIndex {
+public:
+    using Node = Graph::Node;
+
+    PagedIndex(Graph& graph, double alpha_index, string file_path, size_t cache_bytes, Node page_source_count = 64, int readahead_thread_count = 1);
+    static void generate_index_to_file(Graph& graph, double alpha_index, double size_ratio, string file_path, size_t buffer_bytes = 1 << 26);
+
+    double get_alpha_index() const {return alpha_index;}
+    const IndexPagePool& get_pool() const {return *pool;}
+    void reset_referred_count_map() {referred_count_map.clear();}
+    void get(Node source_id, vector<Node>& path);
+    void get(Node source_id, int max_len, vector<Node>& path);
+    void get_paths(Node source_id, long long walk_count, double alpha, vector<vector<Node>>& paths) {
+        reset_referred_count_map();
+        _get_paths(source_id, walk_count, alpha, paths);
+    }
+    void calc_ppr_by_fora_plus(const map<Node, double>& src_map, double alpha, long long walk_count, unordered_map<Node, double>& ppr);
+
+private:
+    Graph& graph;
+    double alpha_index;
+    shared_ptr<IndexPagePool> pool;
+    unordered_map<Node, int> referred_count_map;
+    int ring_size = 64;
+
+    void _get_paths(Node source_id, long long walk_count, double alpha, vector<vector<Node>>& paths);
+};
+
+#endif
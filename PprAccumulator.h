@@ -0,0 +1,102 @@
+#ifndef PPR_ACCUMULATOR_H_
+#define PPR_ACCUMULATOR_H_
+#include "Graph.h"
+
+// Sums the walk weights of the FORA walk phase per end node, in place of ppr[node] += val on an unordered_map.
+// Walk weights are positive. Not thread-safe: each query thread uses its own accumulator.
+//
+// Dense mode, for queries whose walks cover a large part of the graph: one slot per node plus the list of
+// nodes touched. Sparse mode: an open-addressing table (linear probing) that starts at min(max_entry_count, 2^14)
+// entries and doubles at half load, so a probe always reaches an empty slot.
+class PprAccumulator {
+public:
+    PprAccumulator(Node node_count, long long max_entry_count) : node_count(node_count) {
+        assert(node_count > 0 && max_entry_count >= 0);
+        long long entry_bound = min((long long)node_count, max(max_entry_count, 1LL));
+        dense = entry_bound * 4 >= node_count;
+        if (dense) {
+            val_list.assign(node_count, 0);
+        } else {
+            size_t initial_capacity = 16;
+            while (initial_capacity < (size_t)min(entry_bound, 1LL << 14) * 2) initial_capacity *= 2;
+            _allocate(initial_capacity);
+        }
+    }
+
+    bool is_dense() const {return dense;}
+
+    void add(Node node_id, double val) {
+        assert(0 <= node_id && node_id < node_count && val > 0);
+        if (dense) {
+            if (val_list[node_id] == 0) touched_list.push_back(node_id);
+            val_list[node_id] += val;
+            return;
+        }
+        size_t mask = capacity - 1;
+        for (size_t slot = _hash(node_id) & mask; ; slot = (slot + 1) & mask) {
+            if (key_list[slot] == -1) {
+                if (++entry_count * 2 > capacity) {
+                    _grow();
+                    add(node_id, val);
+                    return;
+                }
+                key_list[slot] = node_id;
+            }
+            if (key_list[slot] == node_id) {
+                val_list[slot] += val;
+                return;
+            }
+        }
+    }
+
+    void add_to(unordered_map<Node, double>& ppr) const {
+        _for_each([&](Node node_id, double val) {ppr[node_id] += val;});
+    }
+
+    // (node_id, val) of every added node, sorted by node_id.
+    void export_sorted(vector<pair<Node, double>>& entry_list) const {
+        entry_list.clear();
+        _for_each([&](Node node_id, double val) {entry_list.emplace_back(node_id, val);});
+        sort(entry_list.begin(), entry_list.end());
+    }
+
+private:
+    Node node_count;
+    bool dense;
+    // dense mode: sum of each node. sparse mode: sum of each slot.
+    vector<double> val_list;
+    vector<Node> touched_list;
+    // sparse mode: node of each slot, -1 if empty
+    size_t capacity = 0;
+    size_t entry_count = 0;
+    vector<Node> key_list;
+
+    void _allocate(size_t new_capacity) {
+        capacity = new_capacity;
+        val_list.assign(capacity, 0);
+        key_list.assign(capacity, -1);
+    }
+
+    void _grow() {
+        vector<pair<Node, double>> entry_list;
+        _for_each([&](Node node_id, double val) {entry_list.emplace_back(node_id, val);});
+        _allocate(capacity * 2);
+        entry_count = 0;
+        for (const auto&[node_id, val] : entry_list) add(node_id, val);
+    }
+
+    static size_t _hash(Node node_id) {return (uint64_t)node_id * 0x9E3779B97F4A7C15ULL >> 16;}
+
+    template <class Func>
+    void _for_each(Func func) const {
+        if (dense) {
+            for (Node node_id : touched_list) func(node_id, val_list[node_id]);
+            return;
+        }
+        for (size_t slot = 0; slot < capacity; slot++) {
+            if (key_list[slot] != -1) func(key_list[slot], val_list[slot]);
+        }
+    }
+};
+
+#endif
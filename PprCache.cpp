@@ -0,0 +1,206 @@
+#include "PprCache.h"
+#include <cstring>
+
+static uint64_t mix_bits(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+static uint64_t get_double_bits(double val) {
+    uint64_t bits;
+    memcpy(&bits, &val, sizeof(bits));
+    return bits;
+}
+
+PprCache::PprCache(const Graph& graph, size_t capacity_bytes, size_t sketch_width) : graph(graph), capacity_bytes(capacity_bytes) {
+    size_t width = 16;
+    while (width < sketch_width) width *= 2;
+    sketch.assign(SKETCH_DEPTH * width, 0);
+    sketch_mask = width - 1;
+    sample_size = 10 * width;
+}
+
+void PprCache::calc_ppr_by_fora_plus(Index& index, const map<Node, double>& src_map, double alpha, long long walk_count, unordered_map<Node, double>& ppr, bool enable_thunder) {
+    assert(alpha > 0 && alpha <= 1 && walk_count > 0);
+    map<Node, double> normalized_src_map = get_normalized_map(src_map);
+    uint64_t key = _get_key(normalized_src_map, alpha);
+    shared_ptr<const Entry> cached;
+    {
+        lock_guard<mutex> lock(cache_mutex);
+        _increment_frequency(key);
+        auto it = slot_map.find(key);
+        if (it != slot_map.end() && it->second.entry->alpha == alpha && it->second.entry->src_map == normalized_src_map) {
+            cached = it->second.entry;
+            lru_list.splice(lru_list.begin(), lru_list, it->second.lru_it);
+        }
+    }
+    // walks of an older epoch are not reused
+    const long long epoch = index.get_epoch();
+    const bool walk_reusable = cached && cached->epoch == epoch && cached->walk_count > 0;
+
+    if (walk_reusable && cached->walk_count >= walk_count) {
+        for (const auto&[node_id, val] : cached->push_ppr_list) ppr[node_id] += val;
+        for (const auto&[node_id, val] : cached->walk_ppr_list) ppr[node_id] += val;
+        lock_guard<mutex> lock(cache_mutex);
+        stats.hit_count++;
+        return;
+    }
+
+    shared_ptr<Entry> entry = make_shared<Entry>();
+    entry->src_map = normalized_src_map;
+    entry->alpha = alpha;
+    entry->walk_count = walk_count;
+    unordered_map<Node, double> residue;
+    if (cached) {
+        entry->residue_list = cached->residue_list;
+        entry->push_ppr_list = cached->push_ppr_list;
+        residue.insert(cached->residue_list.begin(), cached->residue_list.end());
+    } else {
+        unordered_map<Node, double> push_ppr;
+        graph.calc_ppr_by_fp(normalized_src_map, alpha, walk_count, residue, push_ppr);
+        residue.erase(-1);
+        push_ppr.erase(-1);
+        for (const auto&[node_id, r_val] : residue) {
+            if (r_val != 0) entry->residue_list.emplace_back(node_id, r_val);
+        }
+        entry->push_ppr_list.assign(push_ppr.begin(), push_ppr.end());
+    }
+
+    // The new walks continue after the stored paths the cached ones read, so both are independent
+    // and are combined weighted by their walk counts.
+    long long cached_walk_count = walk_reusable ? cached->walk_count : 0;
+    unordered_map<Node, double> extra_walk_ppr, walk_ppr;
+    bool continued = false;
+    if (walk_reusable) {
+        entry->referred_count_list = cached->referred_count_list;
+        continued = index.continue_walk_ppr_by_fora_plus(residue, alpha, walk_count - cached_walk_count, cached->epoch, entry->referred_count_list, extra_walk_ppr, enable_thunder);
+    }
+    if (!continued) {
+        // no cached walks, or a refresh was published since the check above
+        cached_walk_count = 0;
+        index.calc_walk_ppr_by_fora_plus(residue, alpha, walk_count, extra_walk_ppr, enable_thunder);
+        entry->referred_count_list.clear();
+        for (const auto&[node_id, referred_count] : index.get_referred_count_map()) {
+            if (referred_count > 0) entry->referred_count_list.emplace_back(node_id, referred_count);
+        }
+    }
+    const long long extra_walk_count = walk_count - cached_walk_count;
+    entry->epoch = index.get_snapshot_epoch();
+    if (continued) {
+        for (const auto&[node_id, val] : cached->walk_ppr_list) walk_ppr[node_id] += val * cached_walk_count / walk_count;
+    }
+    for (const auto&[node_id, val] : extra_walk_ppr) walk_ppr[node_id] += val * extra_walk_count / walk_count;
+    entry->walk_ppr_list.assign(walk_ppr.begin(), walk_ppr.end());
+    sort(entry->walk_ppr_list.begin(), entry->walk_ppr_list.end());
+    _set_bytes(*entry);
+
+    for (const auto&[node_id, val] : entry->push_ppr_list) ppr[node_id] += val;
+    for (const auto&[node_id, val] : entry->walk_ppr_list) ppr[node_id] += val;
+
+    lock_guard<mutex> lock(cache_mutex);
+    if (!cached) stats.miss_count++;
+    else stats.top_up_count++;
+    if (cached && cached->walk_count > 0 && !continued) stats.invalidate_count++;
+    _admit(key, entry);
+}
+
+PprCache::Stats PprCache::get_stats() const {
+    lock_guard<mutex> lock(cache_mutex);
+    return stats;
+}
+
+size_t PprCache::get_size_bytes() const {
+    lock_guard<mutex> lock(cache_mutex);
+    return size_bytes;
+}
+
+uint64_t PprCache::_get_key(const map<Node, double>& src_map, double alpha) {
+    uint64_t key = mix_bits(get_double_bits(alpha));
+    for (const auto&[node_id, val] : src_map) {
+        key = mix_bits(key ^ (uint64_t)node_id);
+        key = mix_bits(key ^ get_double_bits(val));
+    }
+    return key;
+}
+
+// Approximate heap usage of an entry, including its slot in slot_map and lru_list.
+void PprCache::_set_bytes(Entry& entry) {
+    entry.bytes = sizeof(Entry) + sizeof(Slot) + 64
+        + (entry.residue_list.capacity() + entry.push_ppr_list.capacity() + entry.walk_ppr_list.capacity()) * sizeof(pair<Node, double>)
+        + entry.referred_count_list.capacity() * sizeof(pair<Node, int>)
+        + entry.src_map.size() * 48;
+}
+
+size_t PprCache::_get_sketch_suf(uint64_t key, int row) const {
+    return row * (sketch_mask + 1) + (mix_bits(key + row * 0x9E3779B97F4A7C15ULL) & sketch_mask);
+}
+
+void PprCache::_increment_frequency(uint64_t key) {
+    for (int row = 0; row < SKETCH_DEPTH; row++) {
+        uint8_t& counter = sketch[_get_sketch_suf(key, row)];
+        if (counter < UINT8_MAX) counter++;
+    }
+    if (++sample_count >= sample_size) {
+        for (uint8_t& counter : sketch) counter /= 2;
+        sample_count /= 2;
+    }
+}
+
+int PprCache::_get_frequency(uint64_t key) const {
+    int frequency = UINT8_MAX;
+    for (int row = 0; row < SKETCH_DEPTH; row++) frequency = min(frequency, (int)sketch[_get_sketch_suf(key, row)]);
+    return frequency;
+}
+
+void PprCache::_erase(uint64_t key) {
+    auto it = slot_map.find(key);
+    size_bytes -= it->second.entry->bytes;
+    lru_list.erase(it->second.lru_it);
+    slot_map.erase(it);
+}
+
+// Admission runs before anything is removed. An existing entry of the same key is only replaced once the new one
+// is admitted, and its bytes count as freed.
+void PprCache::_admit(uint64_t key, shared_ptr<const Entry> entry) {
+    auto it = slot_map.find(key);
+    size_t replaced_bytes = 0;
+    if (it != slot_map.end()) {
+        // another thread may have cached more walks of the same epoch meanwhile
+        const Entry& current = *it->second.entry;
+        if (current.epoch == entry->epoch && current.walk_count >= entry->walk_count && current.src_map == entry->src_map) return;
+        replaced_bytes = current.bytes;
+    }
+    if (entry->bytes > capacity_bytes) {
+        stats.reject_count++;
+        return;
+    }
+
+    // the least recently used entries that would have to go must all be requested less often
+    int frequency = _get_frequency(key);
+    size_t freed_bytes = replaced_bytes;
+    vector<uint64_t> victim_list;
+    for (auto lru_it = lru_list.rbegin(); size_bytes - freed_bytes + entry->bytes > capacity_bytes; ++lru_it) {
+        if (*lru_it == key) continue;
+        if (_get_frequency(*lru_it) >= frequency) {
+            stats.reject_count++;
+            return;
+        }
+        freed_bytes += slot_map.at(*lru_it).entry->bytes;
+        victim_list.push_back(*lru_it);
+    }
+    for (uint64_t victim_key : victim_list) _erase(victim_key);
+    stats.evict_count += victim_list.size();
+
+    if (it != slot_map.end()) {
+        it->second.entry = entry;
+        lru_list.splice(lru_list.begin(), lru_list, it->second.lru_it);
+    } else {
+        lru_list.push_front(key);
+        slot_map[key] = {entry, lru_list.begin()};
+    }
+    size_bytes = size_bytes - replaced_bytes + entry->bytes;
+}
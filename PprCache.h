@@ -0,0 +1,83 @@
+#ifndef PPR_CACHE_H_
+#define PPR_CACHE_H_
+#include "Index.h"
+#include <list>
+#include <mutex>
+
+// Memory-bounded cache of Index::calc_ppr_by_fora_plus results for hot sources, shared by query threads.
+//
+// An entry keeps the forward push of one (src_map, alpha), i.e. its residues and push estimate, together with
+// the walk estimate so far and the walk_count it was computed with. A request for a larger walk_count only runs
+// the missing walk_count - cached walk_count from the cached residues and combines both walk estimates
+// weighted by their walk counts. A request for at most the cached walk_count is answered without any walk.
+// The top-up walks skip the stored paths the cached walks read (Index::continue_walk_ppr_by_fora_plus),
+// so both sets of walks are independent. The cached push keeps the threshold of the first walk_count,
+// so a top-up leaves more residue to the walks than a fresh query would.
+// The push only depends on the graph, so when the Index publishes a new epoch the entry drops its walk estimate
+// and keeps the push.
+//
+// Admission is TinyLFU: a count-min sketch tracks how often each key was requested, and a new entry
+// that needs room only replaces least recently used entries that were requested less often than itself.
+class PprCache {
+public:
+    struct Stats {
+        long long hit_count = 0;       // answered from the cache
+        long long top_up_count = 0;    // cached push reused, some walks run
+        long long miss_count = 0;
+        long long reject_count = 0;    // computed but not admitted
+        long long evict_count = 0;
+        long long invalidate_count = 0;  // walk estimate dropped for a newer epoch
+    };
+
+    PprCache(const Graph& graph, size_t capacity_bytes, size_t sketch_width = 1 << 16);
+
+    // Same result as index.calc_ppr_by_fora_plus(src_map, alpha, walk_count, ppr, enable_thunder),
+    // where index is the calling thread's own copy.
+    void calc_ppr_by_fora_plus(Index& index, const map<Node, double>& src_map, double alpha, long long walk_count, unordered_map<Node, double>& ppr, bool enable_thunder);
+    Stats get_stats() const;
+    size_t get_size_bytes() const;
+
+private:
+    // Immutable once cached. A top-up makes a new entry.
+    struct Entry {
+        map<Node, double> src_map;
+        double alpha;
+        vector<pair<Node, double>> residue_list;
+        vector<pair<Node, double>> push_ppr_list;
+        vector<pair<Node, double>> walk_ppr_list;  // sorted by node
+        long long walk_count;  // 0 if there is no walk estimate
+        vector<pair<Node, int>> referred_count_list;  // referred counts of the Index after the walks
+        long long epoch;
+        size_t bytes;
+    };
+    struct Slot {
+        shared_ptr<const Entry> entry;
+        list<uint64_t>::iterator lru_it;
+    };
+
+    const Graph& graph;
+    size_t capacity_bytes;
+    size_t size_bytes = 0;
+    unordered_map<uint64_t, Slot> slot_map;
+    list<uint64_t> lru_list;  // most recently used first
+
+    // count-min sketch of request counts, halved every sample_size requests so that old popularity fades
+    static constexpr int SKETCH_DEPTH = 4;
+    vector<uint8_t> sketch;
+    size_t sketch_mask;
+    long long sample_size;
+    long long sample_count = 0;
+
+    Stats stats;
+    mutable mutex cache_mutex;
+
+    static uint64_t _get_key(const map<Node, double>& src_map, double alpha);
+    static void _set_bytes(Entry& entry);
+    size_t _get_sketch_suf(uint64_t key, int row) const;
+    void _increment_frequency(uint64_t key);
+    int _get_frequency(uint64_t key) const;
+    void _erase(uint64_t key);
+    void _admit(uint64_t key, shared_ptr<const Entry> entry);
+};
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef QUERY_PROTOCOL_H_
+#define QUERY_PROTOCOL_H_
+#include <cstdint>
+#include <cerrno>
+#include <unistd.h>
+
+// Binary protocol between query_server and its clients over a Unix domain socket.
+// A client writes QueryRequest records and reads back one response per request.
+// Responses of one connection may come back in a different order; match them by request_id.
+//
+// response = QueryResponseHeader + payload_bytes of payload
+//   QUERY_PPR   : payload_count records of {int64 node_id, double score}
+//   QUERY_PATHS : payload_count paths, each {int64 length, length * int64 node_id}
+
+enum QueryType : uint32_t {
+    QUERY_PPR = 0,
+    QUERY_PATHS = 1,
+};
+
+enum QueryEngine : uint32_t {
+    ENGINE_THUNDER = 0, // Graph walks, batched across requests into a shared ring
+    ENGINE_INDEX = 1,   // Index::calc_ppr_by_fora_plus / Index::get_paths
+};
+
+enum QueryStatus : uint32_t {
+    STATUS_OK = 0,
+    STATUS_BAD_REQUEST = 1,
+};
+
+#pragma pack(push, 1)
+struct QueryRequest {
+    uint64_t request_id;
+    uint32_t type;
+    uint32_t engine;
+    int64_t source_id;
+    double alpha;
+    int64_t walk_count;
+};
+
+struct QueryResponseHeader {
+    uint64_t request_id;
+    uint32_t status;
+    uint32_t reserved;
+    uint64_t payload_count;
+    uint64_t payload_bytes;
+};
+
+struct PprEntry {
+    int64_t node_id;
+    double score;
+};
+#pragma pack(pop)
+
+// Read exactly size bytes. Returns false on EOF or error.
+inline bool read_full(int fd, void* buf, size_t size) {
+    char* p = static_cast<char*>(buf);
+    while (size > 0) {
+        ssize_t n = ::read(fd, p, size);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+// Write exactly size bytes. Returns false on error.
+inline bool write_full(int fd, const void* buf, size_t size) {
+    const char* p = static_cast<const char*>(buf);
+    while (size > 0) {
+        ssize_t n = ::write(fd, p, size);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+#endif
@@ -0,0 +1,116 @@
+#include "ResultWriter.h"
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+
+template <class T>
+static void append_binary(string& chunk, const T& val) {
+    chunk.append(reinterpret_cast<const char*>(&val), sizeof(T));
+}
+
+template <class T>
+static void append_text(string& chunk, T val) {
+    char buf[32];
+    auto [end, ec] = to_chars(buf, buf + sizeof(buf), val);
+    chunk.append(buf, end);
+}
+
+void ResultFormatter::_format_query_header(long long query_id, Node source_id, double alpha, unsigned long long count, string& chunk) const {
+    if (format == ResultFormat::BINARY) {
+        append_binary(chunk, (uint64_t)query_id);
+        append_binary(chunk, (int64_t)source_id);
+        append_binary(chunk, alpha);
+        append_binary(chunk, (uint64_t)count);
+    } else {
+        chunk += "# ";
+        append_text(chunk, query_id);
+        chunk += ' ';
+        append_text(chunk, source_id);
+        chunk += ' ';
+        append_text(chunk, alpha);
+        chunk += '\n';
+    }
+}
+
+void ResultFormatter::format_ppr(long long query_id, Node source_id, double alpha, const unordered_map<Node, double>& ppr, string& chunk) const {
+    vector<pair<Node, double>> sorted_ppr(ppr.begin(), ppr.end());
+    sort(sorted_ppr.begin(), sorted_ppr.end());
+
+    _format_query_header(query_id, source_id, alpha, sorted_ppr.size(), chunk);
+    for (const auto&[node_id, score] : sorted_ppr) {
+        if (format == ResultFormat::BINARY) {
+            append_binary(chunk, (int64_t)node_id);
+            append_binary(chunk, score);
+        } else {
+            append_text(chunk, node_id);
+            chunk += ' ';
+            append_text(chunk, score);
+            chunk += '\n';
+        }
+    }
+}
+
+void ResultFormatter::format_paths(long long query_id, Node source_id, double alpha, const vector<vector<Node>>& paths, string& chunk) const {
+    _format_query_header(query_id, source_id, alpha, paths.size(), chunk);
+    format_corpus(paths, chunk);
+}
+
+void ResultFormatter::format_corpus(const vector<vector<Node>>& paths, string& chunk) const {
+    for (const vector<Node>& path : paths) {
+        if (format == ResultFormat::BINARY) {
+            append_binary(chunk, (int64_t)path.size());
+            chunk.append(reinterpret_cast<const char*>(path.data()), path.size() * sizeof(Node));
+        } else {
+            for (Node node : path) {
+                append_text(chunk, node);
+                chunk += ' ';
+            }
+            chunk += '\n';
+        }
+    }
+}
+
+ResultWriter::ResultWriter(string file_path, ResultFormat format, ResultMode mode, size_t buffer_size) : buffer(buffer_size) {
+    file = fopen(file_path.c_str(), "wb");
+    if (file == nullptr) {
+        throw std::runtime_error("Failed to open file for writing: " + file_path);
+    }
+    setvbuf(file, nullptr, _IONBF, 0);
+    if (format == ResultFormat::BINARY) {
+        const uint32_t version = 1;
+        _write_raw("AFWB", 4);
+        _write_raw(reinterpret_cast<const char*>(&version), sizeof(version));
+        _write_raw(reinterpret_cast<const char*>(&mode), sizeof(mode));
+    }
+}
+
+// Call flush() before destruction to see write errors.
+ResultWriter::~ResultWriter() {
+    if (buffer_used > 0) fwrite(buffer.data(), 1, buffer_used, file);
+    fclose(file);
+}
+
+void ResultWriter::write(const string& chunk) {
+    _write_raw(chunk.data(), chunk.size());
+}
+
+void ResultWriter::flush() {
+    if (buffer_used == 0) return;
+    if (fwrite(buffer.data(), 1, buffer_used, file) != buffer_used) {
+        throw std::runtime_error("Failed to write results");
+    }
+    buffer_used = 0;
+}
+
+void ResultWriter::_write_raw(const char* data, size_t size) {
+    if (buffer_used + size > buffer.size()) flush();
+    if (size > buffer.size()) {
+        // larger than the whole buffer: write through
+        if (fwrite(data, 1, size, file) != size) {
+            throw std::runtime_error("Failed to write results");
+        }
+        return;
+    }
+    memcpy(buffer.data() + buffer_used, data, size);
+    buffer_used += size;
+}
@@ -0,0 +1,54 @@
+#ifndef RESULT_WRITER_H_
+#define RESULT_WRITER_H_
+#include "Graph.h"
+#include <cstdio>
+
+// Output of batch_query and node2vec_corpus.
+//
+// binary format (little endian)
+//   file header  : "AFWB" , uint32 version , uint32 mode (0 = ppr, 1 = paths, 2 = corpus)
+//   per query    : uint64 query_id , int64 source_id , double alpha , uint64 count , payload
+//     ppr   : count records of {int64 node_id, double score}, sorted by node_id
+//     paths : count paths, each {int64 length, length * int64 node_id}
+//   corpus       : walks only, each {int64 length, length * int64 node_id}
+//
+// text format
+//   per query    : "# query_id source_id alpha" line, then
+//     ppr   : one "node_id score" line per node, sorted by node_id
+//     paths : one line per path, node ids separated by spaces
+//   corpus       : one line per walk, node ids separated by spaces (word2vec style)
+
+enum class ResultFormat {TEXT, BINARY};
+enum class ResultMode : uint32_t {PPR = 0, PATHS = 1, CORPUS = 2};
+
+// Serializes the result of one query into a byte chunk. Used by worker threads.
+class ResultFormatter {
+public:
+    ResultFormatter(ResultFormat format) : format(format) {}
+    void format_ppr(long long query_id, Node source_id, double alpha, const unordered_map<Node, double>& ppr, string& chunk) const;
+    void format_paths(long long query_id, Node source_id, double alpha, const vector<vector<Node>>& paths, string& chunk) const;
+    void format_corpus(const vector<vector<Node>>& paths, string& chunk) const;
+
+private:
+    ResultFormat format;
+
+    void _format_query_header(long long query_id, Node source_id, double alpha, unsigned long long count, string& chunk) const;
+};
+
+// Buffered writer of chunks. Only flushes to the file when the buffer is full.
+class ResultWriter {
+public:
+    ResultWriter(string file_path, ResultFormat format, ResultMode mode, size_t buffer_size = 1 << 24);
+    ~ResultWriter();
+    void write(const string& chunk);
+    void flush();
+
+private:
+    FILE* file;
+    vector<char> buffer;
+    size_t buffer_used = 0;
+
+    void _write_raw(const char* data, size_t size);
+};
+
+#endif
@@ -0,0 +1,280 @@
+#include "ShardedWalk.h"
+
+void ShardRing::init(size_t capacity) {
+    head.store(0);
+    tail.store(0);
+    this->capacity = capacity;
+}
+
+bool ShardRing::push(const ShardMessage& message) {
+    uint64_t t = tail.load(memory_order_relaxed);
+    if (t - head.load(memory_order_acquire) >= capacity) return false;
+    _slots()[t % capacity] = message;
+    tail.store(t + 1, memory_order_release);
+    return true;
+}
+
+bool ShardRing::pop(ShardMessage& message) {
+    uint64_t h = head.load(memory_order_relaxed);
+    if (h == tail.load(memory_order_acquire)) return false;
+    message = _slots()[h % capacity];
+    head.store(h + 1, memory_order_release);
+    return true;
+}
+
+static size_t get_ring_stride(size_t ring_capacity) {
+    return (ShardRing::get_bytes(ring_capacity) + 63) / 64 * 64;
+}
+
+static size_t get_control_stride() {
+    return 4096;
+}
+
+size_t ShardedPprEngine::get_shared_bytes(int shard_count, size_t ring_capacity) {
+    static_assert(sizeof(ShardControl) <= 4096, "ShardControl must fit its stride");
+    return get_control_stride() + (size_t)shard_count * shard_count * get_ring_stride(ring_capacity);
+}
+
+void ShardedPprEngine::init_shared(void* shared, int shard_count, size_t ring_capacity) {
+    ShardControl* control = new (shared) ShardControl;
+    pthread_barrierattr_t attr;
+    pthread_barrierattr_init(&attr);
+    pthread_barrierattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_barrier_init(&control->barrier, &attr, shard_count);
+    pthread_barrierattr_destroy(&attr);
+    control->pending_count[0].store(0);
+    control->pending_count[1].store(0);
+    control->shard_count = shard_count;
+    control->ring_capacity = ring_capacity;
+
+    char* ring_base = static_cast<char*>(shared) + get_control_stride();
+    for (int i = 0; i < shard_count * shard_count; i++) {
+        ShardRing* ring = new (ring_base + i * get_ring_stride(ring_capacity)) ShardRing;
+        ring->init(ring_capacity);
+    }
+}
+
+ShardedPprEngine::ShardedPprEngine(const Graph& shard_graph, int shard_id, int shard_count, void* shared)
+    : graph(shard_graph), shard_id(shard_id), shard_count(shard_count), shard_size(shard_graph.get_shard_size(shard_count)),
+      control(static_cast<ShardControl*>(shared)), ring_base(static_cast<char*>(shared) + get_control_stride()), gen(random_device{}() + shard_id) {
+    assert(control->shard_count == shard_count);
+    ring_bytes = get_ring_stride(control->ring_capacity);
+}
+
+// Adds local_pending_count to the round's global count and returns whether any shard has work left.
+// The two counters alternate between rounds, so one can be cleared while the other is in use.
+bool ShardedPprEngine::_any_pending(long long local_pending_count) {
+    atomic<long long>& current = control->pending_count[round % 2];
+    current.fetch_add(local_pending_count);
+    _barrier();
+    bool pending = current.load() > 0;
+    if (shard_id == 0) control->pending_count[(round + 1) % 2].store(0);
+    _barrier();
+    round++;
+    return pending;
+}
+
+void ShardedPprEngine::calc_ppr_by_fora(const map<Node, double>& src_map, double alpha, long long walk_count, unordered_map<Node, double>& local_ppr) {
+    assert(alpha > 0 && alpha <= 1);
+    unordered_map<Node, double> residue;
+    _push_phase(src_map, alpha, walk_count, residue, local_ppr);
+    _walk_phase(residue, alpha, walk_count, local_ppr);
+}
+
+// Forward push with the same thresholds as Graph::calc_ppr_by_fp. Increments for nodes of other shards
+// are summed per node and sent at the end of the round. Mass reaching dangling nodes is dropped.
+void ShardedPprEngine::_push_phase(const map<Node, double>& src_map, double alpha, long long walk_count, unordered_map<Node, double>& residue, unordered_map<Node, double>& local_ppr) {
+    set<Node> active_node_set;
+    queue<Node> active_node_queue;
+    vector<unordered_map<Node, double>> outbox_list(shard_count);
+    auto add_residue = [&](Node node_id, double val) {
+        double& r = residue[node_id];
+        r += val;
+        if (r > graph.get_adj_num(node_id) / (alpha * walk_count) && active_node_set.count(node_id) == 0) {
+            active_node_set.insert(node_id);
+            active_node_queue.push(node_id);
+        }
+    };
+
+    for (const auto&[node_id, val] : get_normalized_map(src_map)) {
+        if (_get_owner(node_id) == shard_id) add_residue(node_id, val);
+    }
+
+    while (true) {
+        while (active_node_queue.size() > 0) {
+            Node node_id = active_node_queue.front();
+            active_node_queue.pop();
+            active_node_set.erase(node_id);
+            double r_val = residue.at(node_id);
+            residue[node_id] = 0;
+            local_ppr[node_id] += alpha * r_val;
+
+            int node_degree = graph.get_adj_num(node_id);
+            double val = (1 - alpha) * r_val / max(node_degree, 1);
+            for (int adj_suf = 0; adj_suf < node_degree; adj_suf++) {
+                Node adj_id = graph.get_adj(node_id, adj_suf);
+                int owner = _get_owner(adj_id);
+                if (owner == shard_id) add_residue(adj_id, val);
+                else outbox_list[owner][adj_id] += val;
+            }
+        }
+
+        long long unsent_count = 0;
+        for (int to_shard = 0; to_shard < shard_count; to_shard++) {
+            unordered_map<Node, double>& outbox = outbox_list[to_shard];
+            ShardRing& ring = _get_ring(shard_id, to_shard);
+            for (auto it = outbox.begin(); it != outbox.end();) {
+                if (!ring.push({it->first, it->second})) break;
+                it = outbox.erase(it);
+                sent_message_count++;
+            }
+            unsent_count += outbox.size();
+        }
+        _barrier();
+
+        ShardMessage message;
+        for (int from_shard = 0; from_shard < shard_count; from_shard++) {
+            ShardRing& ring = _get_ring(from_shard, shard_id);
+            while (ring.pop(message)) add_residue(message.node_id, message.val);
+        }
+        if (!_any_pending(active_node_queue.size() + unsent_count)) break;
+    }
+}
+
+// Walks of FORA from the residues of this shard. A walker stepping onto a node of another shard
+// is sent there and continues in the next round.
+void ShardedPprEngine::_walk_phase(const unordered_map<Node, double>& residue, double alpha, long long walk_count, unordered_map<Node, double>& local_ppr) {
+    vector<ShardMessage> walkers;
+    vector<vector<ShardMessage>> outbox_list(shard_count);
+    for (const auto&[node_id, r_val] : residue) {
+        if (r_val == 0) continue;
+        long long walk_count_i = (long long)ceil(r_val * walk_count);
+        walkers.insert(walkers.end(), walk_count_i, {node_id, r_val / walk_count_i});
+    }
+
+    while (true) {
+        for (const ShardMessage& walker : walkers) {
+            Node current_node = walker.node_id;
+            while (true) {
+                if (rand_0_1(gen) < alpha) {
+                    local_ppr[current_node] += walker.val;
+                    break;
+                }
+                int degree = graph.get_adj_num(current_node);
+                if (degree == 0) break;
+                current_node = graph.get_adj(current_node, rand_int(gen) % degree);
+                int owner = _get_owner(current_node);
+                if (owner != shard_id) {
+                    outbox_list[owner].push_back({current_node, walker.val});
+                    break;
+                }
+            }
+        }
+        walkers.clear();
+        if (!_send_and_receive(outbox_list, walkers)) break;
+    }
+}
+
+// End of a walk round: sends what fits of the outboxes, takes the walkers sent to this shard and
+// returns whether any shard has work left.
+bool ShardedPprEngine::_send_and_receive(vector<vector<ShardMessage>>& outbox_list, vector<ShardMessage>& walkers) {
+    long long unsent_count = 0;
+    for (int to_shard = 0; to_shard < shard_count; to_shard++) {
+        vector<ShardMessage>& outbox = outbox_list[to_shard];
+        ShardRing& ring = _get_ring(shard_id, to_shard);
+        while (!outbox.empty() && ring.push(outbox.back())) {
+            outbox.pop_back();
+            sent_message_count++;
+        }
+        unsent_count += outbox.size();
+    }
+    _barrier();
+
+    ShardMessage message;
+    for (int from_shard = 0; from_shard < shard_count; from_shard++) {
+        ShardRing& ring = _get_ring(from_shard, shard_id);
+        while (ring.pop(message)) walkers.push_back(message);
+    }
+    return _any_pending(walkers.size() + unsent_count);
+}
+
+void ShardedPprEngine::set_index(shared_ptr<const IndexStore> shard_store, double alpha_index) {
+    assert(shard_store->source_start_suf_list.size() == (size_t)(graph.get_shard_end() - graph.get_shard_begin() + 1));
+    this->shard_store = shard_store;
+    this->alpha_index = alpha_index;
+}
+
+void ShardedPprEngine::calc_ppr_by_fora_plus(const map<Node, double>& src_map, double alpha, long long walk_count, unordered_map<Node, double>& local_ppr) {
+    assert(alpha > 0 && alpha <= 1 && shard_store);
+    unordered_map<Node, double> residue;
+    _push_phase(src_map, alpha, walk_count, residue, local_ppr);
+    _index_walk_phase(residue, alpha, walk_count, local_ppr);
+}
+
+// Walk phase of Index::calc_ppr_by_fora_plus. Of the ceil(r * walk_count) walks from a node with residue r,
+// a Binomial(., alpha) number stop there right away. Every other one joins join_count stored walks end to end
+// (Geometric(alpha / alpha_index) + 1 of them if alpha < alpha_index, else 1) and, if alpha > alpha_index,
+// is cut to step_count = Geometric((alpha - alpha_index) / (1 - alpha_index)) + 1 steps, like StoredWalk::get_paths.
+void ShardedPprEngine::_index_walk_phase(const unordered_map<Node, double>& residue, double alpha, long long walk_count, unordered_map<Node, double>& local_ppr) {
+    referred_count_map.clear();
+    vector<ShardMessage> walkers;
+    vector<vector<ShardMessage>> outbox_list(shard_count);
+    GeometricDistribution geo_dist_downscale(alpha < alpha_index ? alpha / alpha_index : 1);
+    GeometricDistribution geo_dist_upscale(alpha > alpha_index ? (alpha - alpha_index) / (1 - alpha_index) : 1);
+    for (const auto&[node_id, r_val] : residue) {
+        if (r_val == 0) continue;
+        long long walk_count_i = (long long)ceil(r_val * walk_count);
+        long long length_1_count = binomial_distribution<long long>(walk_count_i, alpha)(gen);
+        if (length_1_count > 0) local_ppr[node_id] += r_val * length_1_count / walk_count_i;
+        for (long long i = length_1_count; i < walk_count_i; i++) {
+            int join_count = alpha < alpha_index ? geo_dist_downscale.get() + 1 : 1;
+            int step_count = alpha > alpha_index ? geo_dist_upscale.get() + 1 : INT_MAX;
+            walkers.push_back({node_id, r_val / walk_count_i, join_count, step_count});
+        }
+    }
+
+    while (true) {
+        for (const ShardMessage& walker : walkers) _advance_index_walker(walker, local_ppr, outbox_list);
+        walkers.clear();
+        if (!_send_and_receive(outbox_list, walkers)) break;
+    }
+}
+
+// Runs walker, which is at a node of this shard, until it stops or moves to a node of another shard.
+// At node_id it joins the next unread stored walk of node_id. Once they are used up, it steps to a random
+// neighbour instead and ends the current stored walk there with probability alpha_index, as in StoredWalk::get.
+void ShardedPprEngine::_advance_index_walker(ShardMessage walker, unordered_map<Node, double>& local_ppr, vector<vector<ShardMessage>>& outbox_list) {
+    const IndexStore& store = *shard_store;
+    while (true) {
+        const Node local_id = walker.node_id - graph.get_shard_begin();
+        int& referred_count = referred_count_map[walker.node_id];
+        bool joined_walk_ended;
+        if (referred_count < store.source_start_suf_list[local_id + 1] - store.source_start_suf_list[local_id]) {
+            long long path_id = store.source_start_suf_list[local_id] + referred_count++;
+            long long path_start_suf = store.path_start_suf_list[path_id];
+            int path_step_count = store.path_start_suf_list[path_id + 1] - path_start_suf - 1;
+            int step_count = min(path_step_count, walker.step_count);
+            walker.node_id = store.node_in_path_list[path_start_suf + step_count];
+            walker.step_count -= step_count;
+            joined_walk_ended = true;
+        } else {
+            int degree = graph.get_adj_num(walker.node_id);
+            walker.node_id = degree == 0 ? -1 : graph.get_adj(walker.node_id, rand_int(gen) % degree);
+            walker.step_count--;
+            joined_walk_ended = rand_0_1(gen) <= alpha_index;
+        }
+
+        // walks stopping at a dangling node are dropped
+        if (walker.node_id == -1) return;
+        if (joined_walk_ended) walker.join_count--;
+        if (walker.join_count == 0 || walker.step_count == 0) {
+            local_ppr[walker.node_id] += walker.val;
+            return;
+        }
+        int owner = _get_owner(walker.node_id);
+        if (owner != shard_id) {
+            outbox_list[owner].push_back(walker);
+            return;
+        }
+    }
+}
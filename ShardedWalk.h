@@ -0,0 +1,99 @@
+#ifndef SHARDED_WALK_H_
+#define SHARDED_WALK_H_
+#include "Index.h"
+#include <atomic>
+#include <pthread.h>
+
+// FORA over a Graph split by node range across processes on one host.
+//
+// Every shard process loads its own part of the CSR (Graph(data_dir, shard_id, shard_count)) and
+// runs ShardedPprEngine on a shared memory region set up by the parent before fork.
+// Shards proceed in synchronized rounds. In a round, each shard works on its local nodes only and
+// batches what belongs to other shards (residue increments while pushing, walkers while walking)
+// into lock-free single-producer single-consumer rings, one per ordered pair of shards.
+// After a barrier each shard drains its incoming rings, and the rounds end once no shard has work left.
+// Each shard returns the PPR it summed up, and the caller adds them up.
+// For FORA+ (calc_ppr_by_fora_plus) every shard also holds the stored walks of its own nodes
+// (Index::load_store_slice). A walker is sent to the shard owning the node whose stored walks or edges it needs next.
+
+// A residue increment at node_id (push phase), or a walker at node_id with weight val (walk phase).
+// A FORA+ walker also carries the stored walks it still joins and the steps it may still take.
+struct ShardMessage {
+    Node node_id;
+    double val;
+    int join_count;
+    int step_count;
+};
+
+// Single-producer single-consumer ring placed in shared memory. The slots follow the ring itself.
+class ShardRing {
+public:
+    static size_t get_bytes(size_t capacity) {return sizeof(ShardRing) + capacity * sizeof(ShardMessage);}
+    void init(size_t capacity);
+    // Returns false if the ring is full.
+    bool push(const ShardMessage& message);
+    bool pop(ShardMessage& message);
+
+private:
+    alignas(64) atomic<uint64_t> head;  // next slot to pop, written by the consumer
+    alignas(64) atomic<uint64_t> tail;  // next slot to push, written by the producer
+    alignas(64) uint64_t capacity;
+
+    ShardMessage* _slots() {return reinterpret_cast<ShardMessage*>(this + 1);}
+};
+static_assert(atomic<uint64_t>::is_always_lock_free, "ShardRing needs address-free atomics");
+
+class ShardedPprEngine {
+public:
+    // Size of the shared region, and its initialization by the parent before fork.
+    static size_t get_shared_bytes(int shard_count, size_t ring_capacity);
+    static void init_shared(void* shared, int shard_count, size_t ring_capacity);
+
+    ShardedPprEngine(const Graph& shard_graph, int shard_id, int shard_count, void* shared);
+    // Stored walks of the nodes of this shard, with stop probability alpha_index, for calc_ppr_by_fora_plus.
+    void set_index(shared_ptr<const IndexStore> shard_store, double alpha_index);
+
+    // Collective: every shard calls it with the same query. local_ppr gets the PPR of the nodes of this shard.
+    void calc_ppr_by_fora(const map<Node, double>& src_map, double alpha, long long walk_count, unordered_map<Node, double>& local_ppr);
+    // Collective, like calc_ppr_by_fora. The walks are made of stored walks as in Index::calc_ppr_by_fora_plus,
+    // so local_ppr may also hold nodes of other shards. Needs set_index on every shard.
+    void calc_ppr_by_fora_plus(const map<Node, double>& src_map, double alpha, long long walk_count, unordered_map<Node, double>& local_ppr);
+    long long get_sent_message_count() const {return sent_message_count;}
+
+private:
+    struct ShardControl {
+        pthread_barrier_t barrier;
+        atomic<long long> pending_count[2];
+        int shard_count;
+        uint64_t ring_capacity;
+    };
+
+    const Graph& graph;
+    int shard_id;
+    int shard_count;
+    Node shard_size;
+    ShardControl* control;
+    char* ring_base;
+    size_t ring_bytes;
+    int round = 0;
+    long long sent_message_count = 0;
+    shared_ptr<const IndexStore> shard_store;
+    double alpha_index = 0;
+    unordered_map<Node, int> referred_count_map;
+
+    mt19937 gen;
+    uniform_real_distribution<> rand_0_1{0.0, 1.0};
+    uniform_int_distribution<> rand_int{0, INT_MAX};
+
+    int _get_owner(Node node_id) const {return node_id / shard_size;}
+    ShardRing& _get_ring(int from_shard, int to_shard) {return *reinterpret_cast<ShardRing*>(ring_base + (from_shard * shard_count + to_shard) * ring_bytes);}
+    void _barrier() {pthread_barrier_wait(&control->barrier);}
+    bool _any_pending(long long local_pending_count);
+    void _push_phase(const map<Node, double>& src_map, double alpha, long long walk_count, unordered_map<Node, double>& residue, unordered_map<Node, double>& local_ppr);
+    void _walk_phase(const unordered_map<Node, double>& residue, double alpha, long long walk_count, unordered_map<Node, double>& local_ppr);
+    void _index_walk_phase(const unordered_map<Node, double>& residue, double alpha, long long walk_count, unordered_map<Node, double>& local_ppr);
+    void _advance_index_walker(ShardMessage walker, unordered_map<Node, double>& local_ppr, vector<vector<ShardMessage>>& outbox_list);
+    bool _send_and_receive(vector<vector<ShardMessage>>& outbox_list, vector<ShardMessage>& walkers);
+};
+
+#endif
@@ -0,0 +1,208 @@
+#include "Graph.h"
+#include "Index.h"
+#include "PagedIndex.h"
+#include "ResultWriter.h"
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+// Batch query driver.
+// Each line of the query file is "source_id alpha walk_count" or "source_id alpha eps=epsilon".
+// Queries are read lazily and run on worker threads. Their results are written in query order,
+// and a worker waits before taking a query more than window_size ahead of the writer,
+// so memory stays bounded however long the query file is.
+// The paged engine answers from an on-disk PagedIndex, which is built first if the file does not exist.
+
+struct BatchQuery {
+    long long query_id;
+    Node source_id;
+    double alpha;
+    long long walk_count;
+};
+
+class QueryReader {
+public:
+    QueryReader(string file_path, Node node_count) : node_count(node_count) {
+        file.open(file_path, ios::in);
+        if (!file) {
+            throw std::runtime_error("Failed to open file for reading: " + file_path);
+        }
+    }
+
+    long long get_query_count() const {return next_query_id;}
+
+    // Returns false at the end of the query file.
+    bool next(BatchQuery& query) {
+        string line, source_str, alpha_str, count_str;
+        while (getline(file, line)) {
+            stringstream ss{line};
+            if (!(ss >> source_str >> alpha_str >> count_str)) continue;
+            query.query_id = next_query_id++;
+            query.source_id = stoll(source_str);
+            query.alpha = stod(alpha_str);
+            if (count_str.rfind("eps=", 0) == 0) query.walk_count = get_walk_count_for_epsilon(stod(count_str.substr(4)), node_count);
+            else query.walk_count = stoll(count_str);
+            assert(query.source_id >= 0 && query.source_id < node_count);
+            assert(query.alpha > 0 && query.alpha <= 1);
+            return true;
+        }
+        return false;
+    }
+
+private:
+    ifstream file;
+    Node node_count;
+    long long next_query_id = 0;
+};
+
+// Ring of window_size result slots between the workers and the writer.
+class OrderedWindow {
+public:
+    OrderedWindow(size_t window_size) : slots(window_size), ready(window_size, false) {}
+
+    // Blocks until query_id is within the window.
+    void wait_for_slot(long long query_id) {
+        unique_lock<mutex> lock(window_mutex);
+        slot_freed.wait(lock, [&] {return query_id < written_count + (long long)slots.size();});
+    }
+
+    void put(long long query_id, string&& chunk) {
+        {
+            lock_guard<mutex> lock(window_mutex);
+            slots[query_id % slots.size()] = std::move(chunk);
+            ready[query_id % slots.size()] = true;
+        }
+        slot_filled.notify_all();
+    }
+
+    // Blocks until the next result in query order is ready. Returns false once every query is written.
+    bool take_next(string& chunk) {
+        unique_lock<mutex> lock(window_mutex);
+        size_t suf = written_count % slots.size();
+        slot_filled.wait(lock, [&] {return ready[suf] || written_count == total_query_count;});
+        if (!ready[suf]) return false;
+        chunk.swap(slots[suf]);
+        slots[suf].clear();
+        ready[suf] = false;
+        written_count++;
+        slot_freed.notify_all();
+        return true;
+    }
+
+    // Called once all queries are read and put.
+    void set_query_count(long long query_count) {
+        {
+            lock_guard<mutex> lock(window_mutex);
+            total_query_count = query_count;
+        }
+        slot_filled.notify_all();
+    }
+
+private:
+    vector<string> slots;
+    vector<bool> ready;
+    long long written_count = 0;
+    long long total_query_count = -1;
+    mutex window_mutex;
+    condition_variable slot_freed;
+    condition_variable slot_filled;
+};
+
+int main(int argc, char *argv[]) {
+    if (argc < 4) {
+        cerr << "usage: " << argv[0] << " [dataset name] [query file] [output file] [mode: ppr|paths] [format: text|binary] [engine: thunder|mc|index|paged] [thread count] [alpha_index=0.4] [size_ratio=1.0] [paged index file=./dataset/[dataset name]/paged_index.bin] [page cache MB=256]" << endl;
+        return 1;
+    }
+    const string data_dir = argv[1];
+    const string query_file = argv[2];
+    const string output_file = argv[3];
+    const ResultMode mode = (argc > 4 && string(argv[4]) == "paths") ? ResultMode::PATHS : ResultMode::PPR;
+    const ResultFormat format = (argc > 5 && string(argv[5]) == "binary") ? ResultFormat::BINARY : ResultFormat::TEXT;
+    const string engine = argc > 6 ? argv[6] : "thunder";
+    const int thread_count = argc > 7 ? stoi(argv[7]) : max(1u, thread::hardware_concurrency());
+    const double alpha_index = argc > 8 ? stod(argv[8]) : 0.4;
+    const double size_ratio = argc > 9 ? stod(argv[9]) : 1.0;
+    const string paged_index_file = argc > 10 ? argv[10] : "./dataset/" + data_dir + "/paged_index.bin";
+    const size_t page_cache_bytes = (argc > 11 ? stoll(argv[11]) : 256) << 20;
+    const size_t window_size = 4 * thread_count;
+
+    /* Initializing Graph Phase */
+    Graph graph(data_dir);
+    Index index(graph, alpha_index);
+    if (engine == "index") index.generate_index_from_scratch(size_ratio);
+    unique_ptr<PagedIndex> paged_index;
+    if (engine == "paged") {
+        if (!ifstream(paged_index_file)) PagedIndex::generate_index_to_file(graph, alpha_index, size_ratio, paged_index_file);
+        paged_index = make_unique<PagedIndex>(graph, alpha_index, paged_index_file, page_cache_bytes);
+    }
+
+    auto start = chrono::steady_clock::now();
+    QueryReader reader(query_file, graph.get_node_count());
+    mutex reader_mutex;
+    OrderedWindow window(window_size);
+    ResultFormatter formatter(format);
+    ResultWriter writer(output_file, format, mode);
+
+    auto work = [&]() {
+        Index worker_index(index);
+        unique_ptr<PagedIndex> worker_paged_index = paged_index ? make_unique<PagedIndex>(*paged_index) : nullptr;
+        BatchQuery query;
+        while (true) {
+            {
+                lock_guard<mutex> lock(reader_mutex);
+                if (!reader.next(query)) break;
+            }
+            window.wait_for_slot(query.query_id);
+
+            string chunk;
+            if (mode == ResultMode::PPR) {
+                unordered_map<Node, double> ppr;
+                if (engine == "index") {
+                    map<Node, double> src_map{{query.source_id, 1}};
+                    worker_index.calc_ppr_by_fora_plus(src_map, query.alpha, query.walk_count, ppr, true);
+                } else if (engine == "paged") {
+                    worker_paged_index->calc_ppr_by_fora_plus({{query.source_id, 1}}, query.alpha, query.walk_count, ppr);
+                } else if (engine == "mc") {
+                    graph.calc_ppr_by_fora_mc(query.source_id, query.alpha, query.walk_count, ppr);
+                } else {
+                    graph.calc_ppr_by_fora_thunder(query.source_id, query.alpha, query.walk_count, ppr);
+                }
+                formatter.format_ppr(query.query_id, query.source_id, query.alpha, ppr, chunk);
+            } else {
+                vector<vector<Node>> paths;
+                if (engine == "index") worker_index.get_paths(query.source_id, query.walk_count, query.alpha, paths);
+                else if (engine == "paged") worker_paged_index->get_paths(query.source_id, query.walk_count, query.alpha, paths);
+                else if (engine == "mc") graph.get_paths_by_mc(query.source_id, query.alpha, query.walk_count, paths);
+                else graph.get_paths_by_thunderRW(query.source_id, query.alpha, query.walk_count, paths);
+                formatter.format_paths(query.query_id, query.source_id, query.alpha, paths, chunk);
+            }
+            window.put(query.query_id, std::move(chunk));
+        }
+    };
+
+    vector<thread> workers;
+    for (int i = 0; i < thread_count; i++) workers.emplace_back(work);
+
+    thread finisher([&] {
+        for (thread& t : workers) t.join();
+        window.set_query_count(reader.get_query_count());
+    });
+
+    string chunk;
+    long long written_count = 0;
+    while (window.take_next(chunk)) {
+        writer.write(chunk);
+        written_count++;
+    }
+    finisher.join();
+    writer.flush();
+
+    double elapsed_sec = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cerr << written_count << " queries in " << elapsed_sec << " sec" << endl;
+    if (paged_index) {
+        const IndexPagePool& pool = paged_index->get_pool();
+        cerr << "page hits " << pool.get_hit_count() << ", misses " << pool.get_miss_count() << ", readaheads " << pool.get_readahead_count() << endl;
+    }
+    return 0;
+}
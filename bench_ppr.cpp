@@ -0,0 +1,200 @@
+#include "Graph.h"
+#include "Index.h"
+#include <chrono>
+#include <filesystem>
+
+// Accuracy versus time of the FORA implementations.
+// Exact PPR comes from multi-threaded power iteration and is cached under ./dataset/[dataset name]/exact_ppr/.
+// For every method and parameter combination, one CSV line averaged over the sources is written to stdout:
+//   method,alpha,walk_count,alpha_index,size_ratio,source_count,index_build_sec,avg_latency_ms,max_error,avg_error,precision_at_k
+// max_error is the largest additive error over all nodes and sources, avg_error the mean over nodes and sources.
+// fp and fp_batch are the forward push alone, per source and for all sources in one calc_ppr_by_fp_batch call.
+// Batched methods report the latency of the whole batch divided by the source count, so per-query throughput
+// compares directly with the sequential rows.
+
+struct BenchResult {
+    double latency_ms_total = 0;
+    double max_error = 0;
+    double error_total = 0;
+    double precision_total = 0;
+    int source_count = 0;
+};
+
+static vector<double> parse_list(const string& str) {
+    vector<double> val_list;
+    stringstream ss{str};
+    string val;
+    while (getline(ss, val, ',')) val_list.push_back(stod(val));
+    return val_list;
+}
+
+static void load_or_calc_exact_ppr(const Graph& graph, Node source_id, double alpha, int thread_count, vector<double>& exact_ppr) {
+    const double tolerance = 1e-10;
+    filesystem::path cache_dir = "./dataset/" + graph.get_data_dir() + "/exact_ppr";
+    ostringstream file_name;
+    file_name << source_id << "_" << alpha << ".bin";
+    filesystem::path cache_path = cache_dir / file_name.str();
+
+    ifstream ifs(cache_path, ios::binary);
+    if (ifs) {
+        int64_t node_count;
+        ifs.read(reinterpret_cast<char*>(&node_count), sizeof(node_count));
+        if (node_count == graph.get_node_count()) {
+            exact_ppr.resize(node_count);
+            ifs.read(reinterpret_cast<char*>(exact_ppr.data()), node_count * sizeof(double));
+            if (ifs) return;
+        }
+    }
+
+    graph.calc_ppr_by_power_iteration({{source_id, 1}}, alpha, tolerance, thread_count, exact_ppr);
+    filesystem::create_directories(cache_dir);
+    ofstream ofs(cache_path, ios::binary);
+    int64_t node_count = exact_ppr.size();
+    ofs.write(reinterpret_cast<const char*>(&node_count), sizeof(node_count));
+    ofs.write(reinterpret_cast<const char*>(exact_ppr.data()), node_count * sizeof(double));
+}
+
+static vector<Node> get_topk_nodes(const vector<pair<Node, double>>& score_list, int k) {
+    vector<pair<Node, double>> sorted_list(score_list);
+    int topk_size = min((int)sorted_list.size(), k);
+    partial_sort(sorted_list.begin(), sorted_list.begin() + topk_size, sorted_list.end(), [](const pair<Node, double>& a, const pair<Node, double>& b) {return a.second > b.second;});
+    vector<Node> topk_nodes;
+    for (int i = 0; i < topk_size; i++) topk_nodes.push_back(sorted_list[i].first);
+    return topk_nodes;
+}
+
+static void add_result(const vector<double>& exact_ppr, const unordered_map<Node, double>& ppr, double latency_ms, int k, BenchResult& result) {
+    double error_total = 0;
+    double max_error = 0;
+    for (Node node_id = 0; node_id < (Node)exact_ppr.size(); node_id++) {
+        auto it = ppr.find(node_id);
+        double error = fabs(exact_ppr[node_id] - (it == ppr.end() ? 0 : it->second));
+        error_total += error;
+        max_error = max(max_error, error);
+    }
+
+    vector<pair<Node, double>> exact_list, estimate_list;
+    for (Node node_id = 0; node_id < (Node)exact_ppr.size(); node_id++) {
+        if (exact_ppr[node_id] > 0) exact_list.emplace_back(node_id, exact_ppr[node_id]);
+    }
+    for (const auto&[node_id, score] : ppr) {
+        if (node_id != -1) estimate_list.emplace_back(node_id, score);
+    }
+    vector<Node> exact_topk = get_topk_nodes(exact_list, k);
+    vector<Node> estimate_topk = get_topk_nodes(estimate_list, k);
+    set<Node> exact_topk_set(exact_topk.begin(), exact_topk.end());
+    int hit_count = 0;
+    for (Node node_id : estimate_topk) hit_count += exact_topk_set.count(node_id);
+
+    result.latency_ms_total += latency_ms;
+    result.max_error = max(result.max_error, max_error);
+    result.error_total += error_total / exact_ppr.size();
+    result.precision_total += exact_topk.empty() ? 1 : (double)hit_count / exact_topk.size();
+    result.source_count++;
+}
+
+static void print_result(const string& method, double alpha, long long walk_count, double alpha_index, double size_ratio, double index_build_sec, const BenchResult& result) {
+    cout << method << "," << alpha << "," << walk_count << "," << alpha_index << "," << size_ratio << "," << result.source_count << ","
+         << index_build_sec << "," << result.latency_ms_total / result.source_count << "," << result.max_error << ","
+         << result.error_total / result.source_count << "," << result.precision_total / result.source_count << "\n";
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        cerr << "usage: " << argv[0] << " [dataset name] [source count=10] [walk counts=1000,10000,100000] [alphas=0.1,0.2] [alpha_indexes=0.2,0.4] [size_ratios=0.5,1.0] [k=10] [thread count]" << endl;
+        return 1;
+    }
+    const string data_dir = argv[1];
+    const int source_count = argc > 2 ? stoi(argv[2]) : 10;
+    const vector<double> walk_count_list = parse_list(argc > 3 ? argv[3] : "1000,10000,100000");
+    const vector<double> alpha_list = parse_list(argc > 4 ? argv[4] : "0.1,0.2");
+    const vector<double> alpha_index_list = parse_list(argc > 5 ? argv[5] : "0.2,0.4");
+    const vector<double> size_ratio_list = parse_list(argc > 6 ? argv[6] : "0.5,1.0");
+    const int k = argc > 7 ? stoi(argv[7]) : 10;
+    const int thread_count = argc > 8 ? stoi(argv[8]) : max(1u, thread::hardware_concurrency());
+
+    Graph graph(data_dir, true);
+    // fixed seed so that runs compare the same sources
+    mt19937 source_gen(1);
+    uniform_int_distribution<Node> rand_source(0, graph.get_node_count() - 1);
+    vector<Node> source_list;
+    for (int i = 0; i < source_count; i++) source_list.push_back(rand_source(source_gen));
+
+    map<double, vector<vector<double>>> exact_ppr_map;
+    for (double alpha : alpha_list) {
+        for (Node source_id : source_list) {
+            exact_ppr_map[alpha].emplace_back();
+            load_or_calc_exact_ppr(graph, source_id, alpha, thread_count, exact_ppr_map[alpha].back());
+        }
+    }
+
+    cout << "method,alpha,walk_count,alpha_index,size_ratio,source_count,index_build_sec,avg_latency_ms,max_error,avg_error,precision_at_k\n";
+    auto run = [&](const string& method, double alpha, long long walk_count, double alpha_index, double size_ratio, double index_build_sec, auto calc_ppr) {
+        BenchResult result;
+        for (size_t i = 0; i < source_list.size(); i++) {
+            unordered_map<Node, double> ppr;
+            auto start = chrono::steady_clock::now();
+            calc_ppr(source_list[i], ppr);
+            double latency_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+            add_result(exact_ppr_map[alpha][i], ppr, latency_ms, k, result);
+        }
+        print_result(method, alpha, walk_count, alpha_index, size_ratio, index_build_sec, result);
+    };
+    auto run_batch = [&](const string& method, double alpha, long long walk_count, auto calc_ppr_list) {
+        vector<map<Node, double>> src_map_list;
+        for (Node source_id : source_list) src_map_list.push_back({{source_id, 1}});
+        vector<unordered_map<Node, double>> ppr_list;
+        auto start = chrono::steady_clock::now();
+        calc_ppr_list(src_map_list, ppr_list);
+        double latency_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() / source_list.size();
+        BenchResult result;
+        for (size_t i = 0; i < source_list.size(); i++) add_result(exact_ppr_map[alpha][i], ppr_list[i], latency_ms, k, result);
+        print_result(method, alpha, walk_count, 0, 0, 0, result);
+    };
+
+    for (double alpha : alpha_list) {
+        for (double walk_count : walk_count_list) {
+            run("fora_mc", alpha, walk_count, 0, 0, 0, [&](Node source_id, unordered_map<Node, double>& ppr) {
+                graph.calc_ppr_by_fora_mc(source_id, alpha, walk_count, ppr);
+            });
+            run("fora_thunder", alpha, walk_count, 0, 0, 0, [&](Node source_id, unordered_map<Node, double>& ppr) {
+                graph.calc_ppr_by_fora_thunder(source_id, alpha, walk_count, ppr);
+            });
+            run("fora_alias", alpha, walk_count, 0, 0, 0, [&](Node source_id, unordered_map<Node, double>& ppr) {
+                graph.calc_ppr_by_fora_alias(source_id, alpha, walk_count, ppr);
+            });
+            run_batch("fora_thunder_batch", alpha, walk_count, [&](const vector<map<Node, double>>& src_map_list, vector<unordered_map<Node, double>>& ppr_list) {
+                graph.calc_ppr_by_fora_thunder_batch(src_map_list, alpha, walk_count, ppr_list);
+            });
+            run("fp", alpha, walk_count, 0, 0, 0, [&](Node source_id, unordered_map<Node, double>& ppr) {
+                unordered_map<Node, double> residue;
+                graph.calc_ppr_by_fp({{source_id, 1}}, alpha, walk_count, residue, ppr);
+                ppr.erase(-1);
+            });
+            run_batch("fp_batch", alpha, walk_count, [&](const vector<map<Node, double>>& src_map_list, vector<unordered_map<Node, double>>& ppr_list) {
+                vector<vector<pair<Node, double>>> residue_list;
+                graph.calc_ppr_by_fp_batch(src_map_list, alpha, walk_count, residue_list, ppr_list);
+            });
+        }
+    }
+
+    for (double alpha_index : alpha_index_list) {
+        for (double size_ratio : size_ratio_list) {
+            Index index(graph, alpha_index);
+            auto build_start = chrono::steady_clock::now();
+            index.generate_index_from_scratch(size_ratio);
+            double index_build_sec = chrono::duration<double>(chrono::steady_clock::now() - build_start).count();
+
+            for (double alpha : alpha_list) {
+                for (double walk_count : walk_count_list) {
+                    for (bool enable_thunder : {false, true}) {
+                        run(enable_thunder ? "fora_plus_thunder" : "fora_plus", alpha, walk_count, alpha_index, size_ratio, index_build_sec, [&](Node source_id, unordered_map<Node, double>& ppr) {
+                            index.calc_ppr_by_fora_plus({{source_id, 1}}, alpha, walk_count, ppr, enable_thunder);
+                        });
+                    }
+                }
+            }
+        }
+    }
+    return 0;
+}
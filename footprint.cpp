@@ -0,0 +1,37 @@
+#include "Graph.h"
+#include "Index.h"
+
+// Projects the memory of Graph and Index and the index build time from the degree scan,
+// then optionally builds both and reports what they actually hold, for comparison.
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        cerr << "usage: " << argv[0] << " [dataset name] [alpha_index=0.4] [size_ratio=1.0] [build: 0|1] [sec per stored node=1e-7]" << endl;
+        return 1;
+    }
+    const string data_dir = argv[1];
+    const double alpha_index = argc > 2 ? stod(argv[2]) : 0.4;
+    const double size_ratio = argc > 3 ? stod(argv[3]) : 1.0;
+    const bool build = argc > 4 && string(argv[4]) == "1";
+    const double sec_per_stored_node = argc > 5 ? stod(argv[5]) : 1e-7;
+
+    size_t loader_peak_bytes;
+    cout << "== estimated graph" << "\n";
+    Graph::estimate_footprint(data_dir, false, loader_peak_bytes).print(cout);
+    cout << "loader peak " << loader_peak_bytes << " bytes\n";
+    cout << "== estimated index" << "\n";
+    Index::estimate_footprint(data_dir, alpha_index, size_ratio, sec_per_stored_node).print(cout);
+    if (!build) return 0;
+
+    Graph graph(data_dir);
+    cout << "== graph" << "\n";
+    graph.get_footprint().print(cout);
+    Index index(graph, alpha_index);
+    index.generate_index_from_scratch(size_ratio);
+    FootprintReport index_report = index.get_footprint();
+    cout << "== index" << "\n";
+    index_report.print(cout);
+    // the rate to pass as [sec per stored node] for this machine
+    cout << "sec per stored node " << index_report.build_sec / (index_report.path_count * index_report.avg_path_length) << "\n";
+    return 0;
+}
@@ -26,9 +26,9 @@ int main(int argc, char *argv[]) {
             for (Graph::Node node : path) {
                 cout << node << " ";
             }
-            cout << endl;
+            cout << '\n';
         }
-        cout << endl;
+        cout << '\n';
     }
 
     return 0;
@@ -0,0 +1,72 @@
+#include "Graph.h"
+#include "ResultWriter.h"
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+// Writes a node2vec walk corpus: walks_per_node walks of walk_length nodes from every node.
+// Sources are handed to the worker threads in batches, and each finished batch is appended to the output,
+// so memory stays bounded by the batches in flight.
+int main(int argc, char *argv[]) {
+    if (argc < 3) {
+        cerr << "usage: " << argv[0] << " [dataset name] [output file] [walks per node=10] [walk length=80] [p=1.0] [q=1.0] [format: text|binary] [thread count]" << endl;
+        return 1;
+    }
+    const string data_dir = argv[1];
+    const string output_file = argv[2];
+    const int walks_per_node = argc > 3 ? stoi(argv[3]) : 10;
+    const int walk_length = argc > 4 ? stoi(argv[4]) : 80;
+    const double p = argc > 5 ? stod(argv[5]) : 1.0;
+    const double q = argc > 6 ? stod(argv[6]) : 1.0;
+    const ResultFormat format = (argc > 7 && string(argv[7]) == "binary") ? ResultFormat::BINARY : ResultFormat::TEXT;
+    const int thread_count = argc > 8 ? stoi(argv[8]) : max(1u, thread::hardware_concurrency());
+    const Node batch_node_count = 4096;
+
+    Graph graph(data_dir);
+    const Node node_count = graph.get_node_count();
+
+    auto start = chrono::steady_clock::now();
+    ResultFormatter formatter(format);
+    ResultWriter writer(output_file, format, ResultMode::CORPUS);
+    mutex writer_mutex;
+    Node next_batch_start = 0;
+    long long walk_total = 0;
+
+    auto work = [&]() {
+        vector<Node> source_list;
+        vector<vector<Node>> paths;
+        string chunk;
+        while (true) {
+            Node batch_start;
+            {
+                lock_guard<mutex> lock(writer_mutex);
+                if (next_batch_start >= node_count) break;
+                batch_start = next_batch_start;
+                next_batch_start += batch_node_count;
+            }
+            Node batch_end = min(batch_start + batch_node_count, node_count);
+
+            source_list.clear();
+            for (int i = 0; i < walks_per_node; i++) {
+                for (Node node_id = batch_start; node_id < batch_end; node_id++) source_list.push_back(node_id);
+            }
+            paths.clear();
+            graph.get_paths_by_node2vec(source_list, walk_length, p, q, paths);
+            chunk.clear();
+            formatter.format_corpus(paths, chunk);
+
+            lock_guard<mutex> lock(writer_mutex);
+            writer.write(chunk);
+            walk_total += paths.size();
+        }
+    };
+
+    vector<thread> workers;
+    for (int i = 0; i < thread_count; i++) workers.emplace_back(work);
+    for (thread& t : workers) t.join();
+    writer.flush();
+
+    double elapsed_sec = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cerr << walk_total << " walks in " << elapsed_sec << " sec (" << walk_total / elapsed_sec << " walks/sec)" << endl;
+    return 0;
+}
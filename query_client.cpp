@@ -0,0 +1,102 @@
+#include "QueryProtocol.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/un.h>
+using namespace std;
+
+// Load generator for query_server.
+// Each connection sends query_count requests one after another from random sources in [0, source_count),
+// and the latency of every request is measured from send to the end of its response.
+
+static int connect_to(const string& socket_path) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    socket_path.copy(addr.sun_path, min(socket_path.size(), sizeof(addr.sun_path) - 1));
+    if (connect(fd, (sockaddr*)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 3) {
+        cerr << "usage: " << argv[0] << " [socket path] [source count] [connection count=4] [query count per connection=1000] [alpha=0.2] [walk count=1000] [engine: thunder|index] [type: ppr|paths]" << endl;
+        return 1;
+    }
+    const string socket_path = argv[1];
+    const long long source_count = stoll(argv[2]);
+    const int connection_count = argc > 3 ? stoi(argv[3]) : 4;
+    const long long query_count = argc > 4 ? stoll(argv[4]) : 1000;
+    const double alpha = argc > 5 ? stod(argv[5]) : 0.2;
+    const long long walk_count = argc > 6 ? stoll(argv[6]) : 1000;
+    const uint32_t engine = (argc > 7 && string(argv[7]) == "index") ? ENGINE_INDEX : ENGINE_THUNDER;
+    const uint32_t type = (argc > 8 && string(argv[8]) == "paths") ? QUERY_PATHS : QUERY_PPR;
+
+    vector<double> latency_list;
+    mutex latency_mutex;
+    long long error_count = 0;
+
+    auto run_connection = [&](int connection_id) {
+        int fd = connect_to(socket_path);
+        if (fd < 0) {
+            lock_guard<mutex> lock(latency_mutex);
+            cerr << "failed to connect to " << socket_path << endl;
+            error_count += query_count;
+            return;
+        }
+        mt19937 gen(random_device{}());
+        uniform_int_distribution<long long> rand_source(0, source_count - 1);
+        vector<double> local_latency_list;
+        long long local_error_count = 0;
+        vector<char> payload;
+        for (long long i = 0; i < query_count; i++) {
+            QueryRequest request{(uint64_t)(connection_id * query_count + i), type, engine, rand_source(gen), alpha, walk_count};
+            QueryResponseHeader header;
+            auto start = chrono::steady_clock::now();
+            if (!write_full(fd, &request, sizeof(request)) || !read_full(fd, &header, sizeof(header))) {
+                local_error_count += query_count - i;
+                break;
+            }
+            payload.resize(header.payload_bytes);
+            if (!read_full(fd, payload.data(), payload.size())) {
+                local_error_count += query_count - i;
+                break;
+            }
+            local_latency_list.push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - start).count());
+            if (header.status != STATUS_OK || header.request_id != request.request_id) local_error_count++;
+        }
+        close(fd);
+        lock_guard<mutex> lock(latency_mutex);
+        latency_list.insert(latency_list.end(), local_latency_list.begin(), local_latency_list.end());
+        error_count += local_error_count;
+    };
+
+    auto start = chrono::steady_clock::now();
+    vector<thread> threads;
+    for (int i = 0; i < connection_count; i++) threads.emplace_back(run_connection, i);
+    for (thread& t : threads) t.join();
+    double elapsed_sec = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    sort(latency_list.begin(), latency_list.end());
+    auto percentile = [&](double p) {
+        if (latency_list.empty()) return 0.0;
+        size_t suf = min(latency_list.size() - 1, (size_t)(p * latency_list.size()));
+        return latency_list[suf];
+    };
+    cout << "queries " << latency_list.size() << "\n";
+    cout << "errors " << error_count << "\n";
+    cout << "qps " << latency_list.size() / elapsed_sec << "\n";
+    cout << "p50_us " << percentile(0.50) << "\n";
+    cout << "p99_us " << percentile(0.99) << "\n";
+    return error_count == 0 ? 0 : 1;
+}
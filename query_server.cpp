@@ -0,0 +1,305 @@
+#include "Graph.h"
+#include "Index.h"
+#include "IndexRefresher.h"
+#include "PprCache.h"
+#include "QueryProtocol.h"
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+// Resident query server.
+// Graph and Index are loaded once; every worker thread queries through its own copy of Index,
+// which shares the stored paths.
+// Requests from all connections go to one bounded queue. A worker takes up to max_batch of them at once.
+// The thunder PPR requests of one batch with the same alpha are pushed and walked together
+// (calc_ppr_by_fora_thunder_batch), and its thunder path requests share one ring.
+// Index PPR requests go through a PprCache when one is given.
+
+struct Connection {
+    int fd;
+    mutex write_mutex;
+    ~Connection() {close(fd);}
+};
+
+struct PendingQuery {
+    QueryRequest request;
+    shared_ptr<Connection> connection;
+};
+
+// Requests waiting for a worker. At most max_size of them are queued: a connection that sends faster than
+// the workers answer blocks in push, so its socket is not read any further until there is room.
+class QueryQueue {
+public:
+    QueryQueue(size_t max_size) : max_size(max_size) {}
+
+    // Returns false once the queue is stopped.
+    bool push(PendingQuery&& query) {
+        {
+            unique_lock<mutex> lock(queue_mutex);
+            not_full.wait(lock, [this] {return stop_requested || queue.size() < max_size;});
+            if (stop_requested) return false;
+            queue.push_back(std::move(query));
+        }
+        not_empty.notify_one();
+        return true;
+    }
+
+    // Wait for at least one query, then take up to max_batch of them. Returns false once the queue is stopped.
+    bool pop_batch(size_t max_batch, vector<PendingQuery>& batch) {
+        {
+            unique_lock<mutex> lock(queue_mutex);
+            not_empty.wait(lock, [this] {return stop_requested || !queue.empty();});
+            if (stop_requested) return false;
+            while (!queue.empty() && batch.size() < max_batch) {
+                batch.push_back(std::move(queue.front()));
+                queue.pop_front();
+            }
+        }
+        not_full.notify_all();
+        return true;
+    }
+
+    // Wakes up every waiting thread. Queued requests are dropped.
+    void stop() {
+        {
+            lock_guard<mutex> lock(queue_mutex);
+            stop_requested = true;
+            queue.clear();
+        }
+        not_empty.notify_all();
+        not_full.notify_all();
+    }
+
+private:
+    size_t max_size;
+    deque<PendingQuery> queue;
+    bool stop_requested = false;
+    mutex queue_mutex;
+    condition_variable not_empty;
+    condition_variable not_full;
+};
+
+static void send_response(const PendingQuery& query, uint32_t status, uint64_t payload_count, const vector<char>& payload) {
+    QueryResponseHeader header{query.request.request_id, status, 0, payload_count, payload.size()};
+    lock_guard<mutex> lock(query.connection->write_mutex);
+    if (!write_full(query.connection->fd, &header, sizeof(header))) return;
+    write_full(query.connection->fd, payload.data(), payload.size());
+}
+
+static void append_raw(vector<char>& payload, const void* data, size_t size) {
+    const char* p = static_cast<const char*>(data);
+    payload.insert(payload.end(), p, p + size);
+}
+
+static void send_ppr(const PendingQuery& query, const unordered_map<Node, double>& ppr) {
+    vector<char> payload;
+    payload.reserve(ppr.size() * sizeof(PprEntry));
+    for (const auto&[node_id, score] : ppr) {
+        PprEntry entry{node_id, score};
+        append_raw(payload, &entry, sizeof(entry));
+    }
+    send_response(query, STATUS_OK, ppr.size(), payload);
+}
+
+static void send_paths(const PendingQuery& query, const vector<vector<Node>>& paths, long long begin, long long end) {
+    vector<char> payload;
+    for (long long i = begin; i < end; i++) {
+        int64_t length = paths.at(i).size();
+        append_raw(payload, &length, sizeof(length));
+        append_raw(payload, paths.at(i).data(), length * sizeof(Node));
+    }
+    send_response(query, STATUS_OK, end - begin, payload);
+}
+
+class QueryServer {
+public:
+    QueryServer(Graph& graph, const Index& index, int worker_count, size_t max_batch, size_t max_queue_size, long long max_walk_count, PprCache* cache = nullptr)
+        : graph(graph), index(index), worker_count(worker_count), max_batch(max_batch), max_walk_count(max_walk_count), cache(cache), queue(max_queue_size) {}
+    ~QueryServer() {stop();}
+
+    void start_workers() {
+        for (int i = 0; i < worker_count; i++) workers.emplace_back(&QueryServer::_work, this);
+    }
+
+    // Drops the queued requests and joins the workers once they finish their current batch.
+    void stop() {
+        queue.stop();
+        for (thread& t : workers) t.join();
+        workers.clear();
+    }
+
+    void serve_connection(int fd) {
+        shared_ptr<Connection> connection = make_shared<Connection>();
+        connection->fd = fd;
+        QueryRequest request;
+        while (read_full(fd, &request, sizeof(request))) {
+            if (!queue.push({request, connection})) return;
+        }
+    }
+
+private:
+    Graph& graph;
+    const Index& index;
+    int worker_count;
+    size_t max_batch;
+    long long max_walk_count;
+    PprCache* cache;
+    QueryQueue queue;
+    vector<thread> workers;
+
+    bool _is_valid(const QueryRequest& request) const {
+        if (request.type != QUERY_PPR && request.type != QUERY_PATHS) return false;
+        if (request.engine != ENGINE_THUNDER && request.engine != ENGINE_INDEX) return false;
+        if (request.source_id < 0 || request.source_id >= graph.get_node_count()) return false;
+        if (!(request.alpha > 0 && request.alpha <= 1)) return false;
+        return request.walk_count > 0 && request.walk_count <= max_walk_count;
+    }
+
+    void _work() {
+        Index worker_index(index);
+        vector<PendingQuery> batch;
+        while (true) {
+            batch.clear();
+            if (!queue.pop_batch(max_batch, batch)) return;
+
+            map<double, vector<const PendingQuery*>> thunder_groups;
+            for (const PendingQuery& query : batch) {
+                const QueryRequest& request = query.request;
+                if (!_is_valid(request)) {
+                    send_response(query, STATUS_BAD_REQUEST, 0, {});
+                } else if (request.engine == ENGINE_THUNDER) {
+                    thunder_groups[request.alpha].push_back(&query);
+                } else if (request.type == QUERY_PPR) {
+                    unordered_map<Node, double> ppr;
+                    map<Node, double> src_map{{request.source_id, 1}};
+                    if (cache) cache->calc_ppr_by_fora_plus(worker_index, src_map, request.alpha, request.walk_count, ppr, true);
+                    else worker_index.calc_ppr_by_fora_plus(src_map, request.alpha, request.walk_count, ppr, true);
+                    send_ppr(query, ppr);
+                } else {
+                    vector<vector<Node>> paths;
+                    worker_index.get_paths(request.source_id, request.walk_count, request.alpha, paths);
+                    send_paths(query, paths, 0, paths.size());
+                }
+            }
+
+            for (const auto&[alpha, group] : thunder_groups) _run_thunder_group(alpha, group);
+        }
+    }
+
+    // The PPR requests of the group run as one calc_ppr_by_fora_thunder_batch, and the path requests share one ring.
+    void _run_thunder_group(double alpha, const vector<const PendingQuery*>& group) {
+        vector<const PendingQuery*> ppr_query_list, paths_query_list;
+        vector<map<Node, double>> src_map_list;
+        vector<long long> walk_count_list;
+        vector<Node> source_list;
+        for (const PendingQuery* query : group) {
+            const QueryRequest& request = query->request;
+            if (request.type == QUERY_PPR) {
+                ppr_query_list.push_back(query);
+                src_map_list.push_back({{request.source_id, 1}});
+                walk_count_list.push_back(request.walk_count);
+            } else {
+                paths_query_list.push_back(query);
+                source_list.insert(source_list.end(), request.walk_count, request.source_id);
+            }
+        }
+
+        if (!ppr_query_list.empty()) {
+            vector<unordered_map<Node, double>> ppr_list;
+            graph.calc_ppr_by_fora_thunder_batch(src_map_list, alpha, walk_count_list, ppr_list);
+            for (size_t i = 0; i < ppr_query_list.size(); i++) send_ppr(*ppr_query_list[i], ppr_list[i]);
+        }
+        if (!paths_query_list.empty()) {
+            vector<vector<Node>> paths;
+            graph.get_paths_by_thunderRW(source_list, alpha, paths);
+            long long first_walk = 0;
+            for (const PendingQuery* query : paths_query_list) {
+                send_paths(*query, paths, first_walk, first_walk + query->request.walk_count);
+                first_walk += query->request.walk_count;
+            }
+        }
+    }
+};
+
+int main(int argc, char *argv[]) {
+    if (argc < 3) {
+        cerr << "usage: " << argv[0] << " [dataset name] [socket path] [alpha_index=0.4] [size_ratio=1.0] [worker count=hardware] [index file] [refresh cpu budget=0 (off), each refresh copies the whole index] [cache MB=0 (off)]" << endl;
+        return 1;
+    }
+    const string data_dir = argv[1];
+    const string socket_path = argv[2];
+    const double alpha_index = argc > 3 ? stod(argv[3]) : 0.4;
+    const double size_ratio = argc > 4 ? stod(argv[4]) : 1.0;
+    const int worker_count = argc > 5 ? stoi(argv[5]) : max(1u, thread::hardware_concurrency());
+    const string index_file = argc > 6 ? argv[6] : "";
+    const double refresh_cpu_budget = argc > 7 ? stod(argv[7]) : 0;
+    const size_t cache_mb = argc > 8 ? stoull(argv[8]) : 0;
+    const size_t max_batch = 64;
+    const size_t max_queue_size = 4096;
+    const long long max_walk_count = 100000000;
+
+    signal(SIGPIPE, SIG_IGN);
+
+    /* Initializing Graph Phase */
+    auto load_start = chrono::steady_clock::now();
+    Graph graph(data_dir);
+    Index index(graph, alpha_index);
+    if (!index_file.empty() && ifstream(index_file).good()) {
+        index.load_index(index_file);
+    } else {
+        index.generate_index_from_scratch(size_ratio);
+        if (!index_file.empty()) index.save_index(index_file);
+    }
+    double load_sec = chrono::duration<double>(chrono::steady_clock::now() - load_start).count();
+    cerr << "Loaded " << data_dir << " (n = " << graph.get_node_count() << ") in " << load_sec << " sec" << endl;
+
+    int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0) {
+        perror("socket");
+        return 1;
+    }
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(addr.sun_path)) {
+        cerr << "socket path is too long: " << socket_path << endl;
+        return 1;
+    }
+    socket_path.copy(addr.sun_path, socket_path.size());
+    unlink(socket_path.c_str());
+    if (bind(listen_fd, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(listen_fd, 128) < 0) {
+        perror("bind");
+        return 1;
+    }
+
+    unique_ptr<PprCache> cache;
+    if (cache_mb > 0) cache = make_unique<PprCache>(graph, cache_mb << 20);
+    QueryServer server(graph, index, worker_count, max_batch, max_queue_size, max_walk_count, cache.get());
+    server.start_workers();
+    unique_ptr<IndexRefresher> refresher;
+    if (refresh_cpu_budget > 0) {
+        refresher = make_unique<IndexRefresher>(index, refresh_cpu_budget);
+        refresher->start();
+    }
+    cerr << "Listening on " << socket_path << " with " << worker_count << " workers" << endl;
+
+    while (true) {
+        int fd = accept(listen_fd, nullptr, nullptr);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            perror("accept");
+            break;
+        }
+        thread(&QueryServer::serve_connection, &server, fd).detach();
+    }
+
+    if (refresher) refresher->stop();
+    server.stop();
+    close(listen_fd);
+    unlink(socket_path.c_str());
+    return 0;
+}
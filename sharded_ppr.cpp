@@ -0,0 +1,160 @@
+#include "Graph.h"
+#include "Index.h"
+#include "ShardedWalk.h"
+#include <chrono>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Runs FORA queries on shard_count local processes, each holding one node range of the graph.
+// With alpha_index > 0 the queries run FORA+ on stored walks, and each shard also loads the stored walks of its
+// node range from the index file. A missing index file is first built by the parent, which then loads the whole graph once.
+// The parent only sets up the shared memory and merges the per-shard results it reads from pipes.
+
+static bool read_all(int fd, void* buf, size_t size) {
+    char* p = static_cast<char*>(buf);
+    while (size > 0) {
+        ssize_t n = read(fd, p, size);
+        if (n <= 0) return false;
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+static bool write_all(int fd, const void* buf, size_t size) {
+    const char* p = static_cast<const char*>(buf);
+    while (size > 0) {
+        ssize_t n = write(fd, p, size);
+        if (n <= 0) return false;
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+static void run_shard(const string& data_dir, int shard_id, int shard_count, void* shared, const vector<Node>& source_list, double alpha, long long walk_count, double alpha_index, const string& index_file, int result_fd) {
+    Graph graph(data_dir, shard_id, shard_count);
+    ShardedPprEngine engine(graph, shard_id, shard_count, shared);
+    if (alpha_index > 0) engine.set_index(Index::load_store_slice(index_file, graph.get_shard_begin(), graph.get_shard_end()), alpha_index);
+    for (Node source_id : source_list) {
+        unordered_map<Node, double> local_ppr;
+        if (alpha_index > 0) engine.calc_ppr_by_fora_plus({{source_id, 1}}, alpha, walk_count, local_ppr);
+        else engine.calc_ppr_by_fora({{source_id, 1}}, alpha, walk_count, local_ppr);
+        vector<ShardMessage> entry_list;
+        entry_list.reserve(local_ppr.size());
+        for (const auto&[node_id, score] : local_ppr) entry_list.push_back({node_id, score});
+        uint64_t entry_count = entry_list.size();
+        write_all(result_fd, &entry_count, sizeof(entry_count));
+        write_all(result_fd, entry_list.data(), entry_count * sizeof(ShardMessage));
+    }
+    long long sent_message_count = engine.get_sent_message_count();
+    write_all(result_fd, &sent_message_count, sizeof(sent_message_count));
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 4) {
+        cerr << "usage: " << argv[0] << " [dataset name] [shard count] [source ids, comma separated] [alpha=0.2] [walk count=100000] [ring capacity=65536] [verify: 0|1] [alpha_index=0 (Monte Carlo walks)] [index file=./dataset/[dataset name]/index_[alpha_index].bin]" << endl;
+        return 1;
+    }
+    const string data_dir = argv[1];
+    const int shard_count = stoi(argv[2]);
+    vector<Node> source_list;
+    {
+        stringstream ss{string(argv[3])};
+        string source_str;
+        while (getline(ss, source_str, ',')) source_list.push_back(stoll(source_str));
+    }
+    const double alpha = argc > 4 ? stod(argv[4]) : 0.2;
+    const long long walk_count = argc > 5 ? stoll(argv[5]) : 100000;
+    const size_t ring_capacity = argc > 6 ? stoull(argv[6]) : 65536;
+    const bool verify = argc > 7 && string(argv[7]) == "1";
+    const double alpha_index = argc > 8 ? stod(argv[8]) : 0;
+    const string index_file = argc > 9 ? argv[9] : "./dataset/" + data_dir + "/index_" + to_string(alpha_index) + ".bin";
+    assert(shard_count >= 1 && alpha_index >= 0 && alpha_index < 1);
+
+    if (alpha_index > 0 && !ifstream(index_file).good()) {
+        Graph graph(data_dir);
+        Index index(graph, alpha_index);
+        index.generate_index_from_scratch(1.0);
+        index.save_index(index_file);
+        cerr << "Built " << index_file << endl;
+    }
+
+    size_t shared_bytes = ShardedPprEngine::get_shared_bytes(shard_count, ring_capacity);
+    void* shared = mmap(nullptr, shared_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shared == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+    ShardedPprEngine::init_shared(shared, shard_count, ring_capacity);
+
+    auto start = chrono::steady_clock::now();
+    vector<int> result_fd_list;
+    vector<pid_t> pid_list;
+    for (int shard_id = 0; shard_id < shard_count; shard_id++) {
+        int fds[2];
+        if (pipe(fds) < 0) {
+            perror("pipe");
+            return 1;
+        }
+        pid_t pid = fork();
+        if (pid == 0) {
+            close(fds[0]);
+            run_shard(data_dir, shard_id, shard_count, shared, source_list, alpha, walk_count, alpha_index, index_file, fds[1]);
+            close(fds[1]);
+            _exit(0);
+        }
+        close(fds[1]);
+        result_fd_list.push_back(fds[0]);
+        pid_list.push_back(pid);
+    }
+
+    // merge query by query, in shard order
+    vector<unordered_map<Node, double>> ppr_list(source_list.size());
+    for (size_t q = 0; q < source_list.size(); q++) {
+        for (int shard_id = 0; shard_id < shard_count; shard_id++) {
+            uint64_t entry_count;
+            if (!read_all(result_fd_list[shard_id], &entry_count, sizeof(entry_count))) {
+                cerr << "shard " << shard_id << " exited early" << endl;
+                return 1;
+            }
+            vector<ShardMessage> entry_list(entry_count);
+            read_all(result_fd_list[shard_id], entry_list.data(), entry_count * sizeof(ShardMessage));
+            for (const ShardMessage& entry : entry_list) ppr_list[q][entry.node_id] += entry.val;
+        }
+    }
+    long long sent_message_total = 0;
+    for (int shard_id = 0; shard_id < shard_count; shard_id++) {
+        long long sent_message_count = 0;
+        read_all(result_fd_list[shard_id], &sent_message_count, sizeof(sent_message_count));
+        sent_message_total += sent_message_count;
+        close(result_fd_list[shard_id]);
+        waitpid(pid_list[shard_id], nullptr, 0);
+    }
+    double elapsed_sec = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    munmap(shared, shared_bytes);
+
+    for (size_t q = 0; q < source_list.size(); q++) {
+        vector<pair<Node, double>> sorted_ppr(ppr_list[q].begin(), ppr_list[q].end());
+        sort(sorted_ppr.begin(), sorted_ppr.end(), [](const pair<Node, double>& a, const pair<Node, double>& b) {return a.second > b.second;});
+        cout << "source " << source_list[q] << "\n";
+        for (size_t i = 0; i < min((size_t)10, sorted_ppr.size()); i++) cout << sorted_ppr[i].first << " " << sorted_ppr[i].second << "\n";
+    }
+    cout << "shards " << shard_count << " queries " << source_list.size() << " sec " << elapsed_sec << " migrated messages " << sent_message_total << "\n";
+
+    if (verify) {
+        Graph graph(data_dir);
+        for (size_t q = 0; q < source_list.size(); q++) {
+            unordered_map<Node, double> ppr;
+            graph.calc_ppr_by_fora_mc(source_list[q], alpha, walk_count, ppr);
+            double max_error = 0;
+            for (const auto&[node_id, score] : ppr) {
+                auto it = ppr_list[q].find(node_id);
+                max_error = max(max_error, fabs(score - (it == ppr_list[q].end() ? 0 : it->second)));
+            }
+            cout << "source " << source_list[q] << " max difference from calc_ppr_by_fora_mc " << max_error << "\n";
+        }
+    }
+    return 0;
+}
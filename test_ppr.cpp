@@ -0,0 +1,181 @@
+#include "Graph.h"
+#include "PagedIndex.h"
+#include "PprCache.h"
+#include <filesystem>
+
+// Statistical checks of the walk-based PPR estimators against calc_ppr_by_power_iteration.
+// Every check compares ppr(s, s) of a few sources s, where an estimator whose walks cannot end at their
+// start node is off by about alpha. Tolerances are 6 standard deviations of the estimate.
+// Top-k checks compare the smallest exact PPR of the returned nodes with the exact k-th largest one,
+// and the PprCache checks also count its hits, top-ups and invalidations.
+// Exits with 1 if any check fails.
+
+static int failed_count = 0;
+
+static void check(const string& name, Node source_id, double estimate, double exact, double sigma) {
+    double tolerance = 6 * sigma + 1e-6;
+    bool ok = fabs(estimate - exact) <= tolerance;
+    if (!ok) failed_count++;
+    cout << (ok ? "ok     " : "FAILED ") << name << " source " << source_id << " estimate " << estimate << " exact " << exact << " tolerance " << tolerance << "\n";
+}
+
+int main(int argc, char *argv[]) {
+    const string data_dir = argc > 1 ? argv[1] : "test";
+    const double alpha = argc > 2 ? stod(argv[2]) : 0.2;
+    const long long walk_count = 1000000;
+
+    Graph graph(data_dir, true);
+    const string paged_index_file = (filesystem::temp_directory_path() / "test_ppr_paged_index.bin").string();
+    vector<Node> source_list;
+    for (Node node_id = 0; node_id < graph.get_node_count() && source_list.size() < 3; node_id++) {
+        if (graph.get_adj_num(node_id) > 0) source_list.push_back(node_id);
+    }
+
+    for (Node source_id : source_list) {
+        vector<double> exact_ppr;
+        graph.calc_ppr_by_power_iteration({{source_id, 1}}, alpha, 1e-12, 1, exact_ppr);
+        const double exact = exact_ppr[source_id];
+        const double walk_sigma = sqrt(exact * (1 - exact) / walk_count);
+
+        // raw walks: the fraction ending at the source is ppr(s, s)
+        vector<Node> endpoint_list;
+        graph.get_endpoints_by_thunderRW(vector<Node>(walk_count, source_id), alpha, endpoint_list);
+        check("get_endpoints_by_thunderRW", source_id, (double)count(endpoint_list.begin(), endpoint_list.end(), source_id) / walk_count, exact, walk_sigma);
+
+        vector<vector<Node>> paths;
+        graph.get_paths_by_thunderRW(source_id, alpha, walk_count, paths);
+        long long self_count = 0;
+        for (const vector<Node>& path : paths) self_count += path.back() == source_id;
+        check("get_paths_by_thunderRW", source_id, (double)self_count / walk_count, exact, walk_sigma);
+
+        // FORA: a query's walks have weights of at most 1 / query_walk_count summing to at most 1,
+        // so its estimate has variance at most 1 / query_walk_count. query_count repeated queries are averaged.
+        const long long query_walk_count = 100;
+        const int query_count = walk_count / query_walk_count;
+        const double fora_sigma = sqrt(1.0 / walk_count);
+        auto check_fora = [&](const string& name, auto calc_ppr) {
+            double total = 0;
+            for (int i = 0; i < query_count; i++) {
+                unordered_map<Node, double> ppr;
+                calc_ppr(ppr);
+                total += ppr[source_id];
+            }
+            check(name, source_id, total / query_count, exact, fora_sigma);
+        };
+        check_fora("calc_ppr_by_fora_mc", [&](unordered_map<Node, double>& ppr) {graph.calc_ppr_by_fora_mc(source_id, alpha, query_walk_count, ppr);});
+        check_fora("calc_ppr_by_fora_thunder", [&](unordered_map<Node, double>& ppr) {graph.calc_ppr_by_fora_thunder(source_id, alpha, query_walk_count, ppr);});
+        check_fora("calc_ppr_by_fora_alias", [&](unordered_map<Node, double>& ppr) {graph.calc_ppr_by_fora_alias(source_id, alpha, query_walk_count, ppr);});
+
+        vector<map<Node, double>> src_map_list(query_count, {{source_id, 1}});
+        vector<unordered_map<Node, double>> ppr_list;
+        graph.calc_ppr_by_fora_thunder_batch(src_map_list, alpha, query_walk_count, ppr_list);
+        double total = 0;
+        for (unordered_map<Node, double>& ppr : ppr_list) total += ppr[source_id];
+        check("calc_ppr_by_fora_thunder_batch", source_id, total / query_count, exact, fora_sigma);
+
+        // Every query reuses the same stored walks, so the index is rebuilt for each group of queries and
+        // sigma is estimated from the spread of the group means. calc_ppr(i, ppr) runs a query of name_list[i].
+        // alpha_index is above alpha so that the downscale ring runs, and the small page cache keeps evicting.
+        const int index_build_count = 100;
+        const int group_size = query_count / index_build_count;
+        const double alpha_index = min(1.0, 2 * alpha);
+        auto check_rebuilt = [&](const vector<string>& name_list, auto build, auto calc_ppr) {
+            vector<vector<double>> group_mean_list(name_list.size());
+            for (int i = 0; i < index_build_count; i++) {
+                build();
+                for (size_t e = 0; e < name_list.size(); e++) {
+                    double group_total = 0;
+                    for (int j = 0; j < group_size; j++) {
+                        unordered_map<Node, double> ppr;
+                        calc_ppr(e, ppr);
+                        group_total += ppr[source_id];
+                    }
+                    group_mean_list[e].push_back(group_total / group_size);
+                }
+            }
+            for (size_t e = 0; e < name_list.size(); e++) {
+                double mean = accumulate(group_mean_list[e].begin(), group_mean_list[e].end(), 0.0) / index_build_count;
+                double square_total = 0;
+                for (double group_mean : group_mean_list[e]) square_total += (group_mean - mean) * (group_mean - mean);
+                check(name_list[e], source_id, mean, exact, sqrt(square_total / (index_build_count - 1) / index_build_count));
+            }
+        };
+
+        unique_ptr<PagedIndex> paged_index;
+        check_rebuilt({"PagedIndex::calc_ppr_by_fora_plus"}, [&] {
+            paged_index.reset();
+            PagedIndex::generate_index_to_file(graph, alpha_index, 1.0, paged_index_file);
+            paged_index = make_unique<PagedIndex>(graph, alpha_index, paged_index_file, 1 << 14, 4, 2);
+        }, [&](size_t e, unordered_map<Node, double>& ppr) {
+            paged_index->calc_ppr_by_fora_plus({{source_id, 1}}, alpha, query_walk_count, ppr);
+        });
+
+        // upscale_index has alpha_index below alpha, so its walks are cut short.
+        // A cache top-up runs a quarter of the walks first and the rest from the cached push.
+        Index index(graph, alpha_index), upscale_index(graph, alpha / 2);
+        check_rebuilt({"Index::calc_ppr_by_fora_plus", "Index::calc_ppr_by_fora_plus without ring", "Index::calc_ppr_by_fora_plus upscale", "PprCache top-up"}, [&] {
+            index.generate_index_from_scratch(1.0);
+            upscale_index.generate_index_from_scratch(1.0);
+        }, [&](size_t e, unordered_map<Node, double>& ppr) {
+            if (e < 2) {
+                index.calc_ppr_by_fora_plus({{source_id, 1}}, alpha, query_walk_count, ppr, e == 0);
+                return;
+            }
+            if (e == 2) {
+                upscale_index.calc_ppr_by_fora_plus({{source_id, 1}}, alpha, query_walk_count, ppr, true);
+                return;
+            }
+            PprCache cache(graph, 1 << 20, 16);
+            unordered_map<Node, double> first_ppr;
+            cache.calc_ppr_by_fora_plus(index, {{source_id, 1}}, alpha, query_walk_count / 4, first_ppr, true);
+            cache.calc_ppr_by_fora_plus(index, {{source_id, 1}}, alpha, query_walk_count, ppr, true);
+        });
+
+        // hit, top-up, and a new epoch that drops the cached walks
+        PprCache cache(graph, 1 << 20);
+        unordered_map<Node, double> first_ppr, hit_ppr, top_up_ppr, invalidated_ppr;
+        cache.calc_ppr_by_fora_plus(index, {{source_id, 1}}, alpha, 1000, first_ppr, true);
+        cache.calc_ppr_by_fora_plus(index, {{source_id, 1}}, alpha, 500, hit_ppr, true);
+        check("PprCache hit", source_id, hit_ppr[source_id], first_ppr[source_id], 0);
+        cache.calc_ppr_by_fora_plus(index, {{source_id, 1}}, alpha, 4000, top_up_ppr, true);
+        index.generate_index_from_scratch(1.0);
+        cache.calc_ppr_by_fora_plus(index, {{source_id, 1}}, alpha, 4000, invalidated_ppr, true);
+        PprCache::Stats stats = cache.get_stats();
+        check("PprCache miss_count", source_id, stats.miss_count, 1, 0);
+        check("PprCache hit_count", source_id, stats.hit_count, 1, 0);
+        check("PprCache top_up_count", source_id, stats.top_up_count, 2, 0);
+        check("PprCache invalidate_count", source_id, stats.invalidate_count, 1, 0);
+
+        // backward push to target s: ppr(s, s) = reserve(s) + sum over v of ppr(s, v) * residue(v), exactly
+        const double r_max = 1e-3;
+        unordered_map<Node, double> residue, reserve;
+        graph.calc_ppr_by_bp(source_id, alpha, r_max, residue, reserve);
+        double bp_estimate = reserve[source_id];
+        for (const auto&[node_id, r_val] : residue) bp_estimate += exact_ppr[node_id] * r_val;
+        check("calc_ppr_by_bp", source_id, bp_estimate, exact, 0);
+
+        // the walk part of the bidirectional estimate averages residues of at most r_max
+        const double bidirectional_sigma = r_max / sqrt(walk_count);
+        check("calc_pair_ppr_by_bidirectional", source_id, graph.calc_pair_ppr_by_bidirectional(source_id, source_id, alpha, r_max, walk_count), exact, bidirectional_sigma);
+        check("Index::calc_pair_ppr_by_bidirectional", source_id, index.calc_pair_ppr_by_bidirectional(source_id, source_id, alpha, r_max, walk_count), exact, bidirectional_sigma);
+
+        // top-k by rounds, with the walks capped at walk_count
+        const int k = 3;
+        vector<double> sorted_exact_ppr(exact_ppr);
+        sort(sorted_exact_ppr.begin(), sorted_exact_ppr.end(), greater<double>());
+        auto check_topk = [&](const string& name, const vector<pair<Node, double>>& topk) {
+            double min_exact = topk.size() == (size_t)k ? 1 : 0;
+            for (const auto&[node_id, estimate] : topk) min_exact = min(min_exact, exact_ppr[node_id]);
+            check(name, source_id, min_exact, sorted_exact_ppr[k - 1], sqrt(1.0 / walk_count));
+        };
+        vector<pair<Node, double>> topk;
+        graph.calc_topk_ppr_by_fora_thunder({{source_id, 1}}, alpha, k, walk_count, topk);
+        check_topk("calc_topk_ppr_by_fora_thunder", topk);
+        index.calc_topk_ppr_by_fora_plus({{source_id, 1}}, alpha, k, walk_count, topk);
+        check_topk("Index::calc_topk_ppr_by_fora_plus", topk);
+    }
+
+    filesystem::remove(paged_index_file);
+    cout << (failed_count == 0 ? "all checks passed" : to_string(failed_count) + " checks failed") << "\n";
+    return failed_count == 0 ? 0 : 1;
+}